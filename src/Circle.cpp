@@ -11,6 +11,9 @@ static const char *const HELP = "Creates a circle with falloff based on user def
 #include "DDImage/DDMath.h"
 #include <math.h>
 
+#include "NukularMath.h"
+#include "RowCache.h"
+
 using namespace DD::Image;
 using namespace std;
 
@@ -27,6 +30,8 @@ class Circle : public Iop
 
     double _radians;
 
+    nukular::RowCache _cache;
+
 public:
     const char *Class() const { return CLASS; }
     const char *node_help() const { return HELP; }
@@ -66,17 +71,22 @@ public:
         info_.set(format());
 
         _radians = M_PI / 180;
-        _internal_expo = (_exponent != 0.0f) ? 1.0f / _exponent : 0.00000001f;
+        _internal_expo = nukular::circle_exponent(_exponent);
+        _cache.validate({_size, _internal_expo}, _center.x, _center.y, true, info_.w(), info_.h());
     }
 
     void engine(int y, int xx, int r, ChannelMask channels, Row &row)
     {
-        for (int x = xx; x < r; x++)
+        nukular::RowCache::Span values = _cache.row(y, xx, r, [this](float dx, float dy) {
+            return nukular::circle(dx, dy, _size, _internal_expo);
+        });
+
+        for (int z = 0; z < 4; z++)
         {
-            for (int z = 0; z < 4; z++)
+            float *out = row.writable(channel[z]);
+            for (int x = xx; x < r; x++)
             {
-                float *out = row.writable(channel[z]);
-                out[x] = pow(max(0.0f, (_size - sqrt((x - _center.x) * (x - _center.x) + (y - _center.y) * (y - _center.y))) / _size), _internal_expo) * _color[z];
+                out[x] = values[x - xx] * _color[z];
             }
         }
     };
@@ -11,6 +11,9 @@ static const char *const HELP = "A radial gradient.\n\n"
 #include "DDImage/DDMath.h"
 #include <math.h>
 
+#include "NukularMath.h"
+#include "RowCache.h"
+
 using namespace DD::Image;
 using namespace std;
 
@@ -26,6 +29,9 @@ class CircularRamp : public Iop
     FormatPair formats;
 
     double _radians;
+    float _cos, _sin;
+
+    nukular::RowCache _cache;
 
 public:
     const char* Class() const { return CLASS; }
@@ -66,24 +72,22 @@ public:
         info_.set(format());
 
         _radians = rotate * M_PI/180;
+        _cos = cos(_radians);
+        _sin = sin(_radians);
+        _cache.validate({rotate}, _center.x, _center.y, false, info_.w(), info_.h());
     }
 
     void engine(int y, int xx, int r, ChannelMask channels, Row& row)
     {
-        for (int x=xx; x<r; x++)
-        {
-            float v_pos = (float)cos(_radians) *
-                              (y - _center.y) +
-                          sin(_radians) * (x - _center.x) + _center.y;
-            float h_pos = (float)-sin(_radians) *
-                              (y - _center.y) +
-                          cos(_radians) * (x - _center.x) + _center.x;
-
-            for (int z=0; z<4; z++){
-                float* out = row.writable(channel[z]);
-                float a = (1 - (0.5 + (atan2(h_pos - _center.x, v_pos - _center.y) / (M_PI * 2)))) * start_c[z];
-                float b = (0.5 + (atan2(h_pos - _center.x, v_pos - _center.y) / (M_PI * 2))) * end_c[z];
-                out[x] = a+b;
+        nukular::RowCache::Span t = _cache.row(y, xx, r, [this](float dx, float dy) {
+            return nukular::ramp(dx, dy, _cos, _sin);
+        });
+
+        for (int z=0; z<4; z++){
+            float* out = row.writable(channel[z]);
+            for (int x=xx; x<r; x++)
+            {
+                out[x] = nukular::ramp_color(t[x - xx], start_c[z], end_c[z]);
             }
         }
     };
@@ -11,6 +11,9 @@ static const char *const HELP = "Radial distributed rays.\n\n"
 #include "DDImage/DDMath.h"
 #include <math.h>
 
+#include "NukularMath.h"
+#include "RowCache.h"
+
 using namespace DD::Image;
 using namespace std;
 
@@ -25,6 +28,9 @@ class CircularRays : public Iop
     FormatPair formats;
 
     double _radians;
+    double _cos, _sin;
+
+    nukular::RowCache _cache;
 
 public:
     const char *Class() const { return CLASS; }
@@ -65,23 +71,23 @@ public:
         info_.set(format());
 
         _radians = _rotate * M_PI / 180;
+        _cos = cos(_radians);
+        _sin = sin(_radians);
+        _cache.validate({_amount, _rotate}, _center.x, _center.y, false, info_.w(), info_.h());
     }
 
     void engine(int y, int xx, int r, ChannelMask channels, Row &row)
     {
-        for (int x = xx; x < r; x++)
+        nukular::RowCache::Span values = _cache.row(y, xx, r, [this](double dx, double dy) {
+            return float(nukular::rays<double>(dx, dy, _cos, _sin, _amount));
+        });
+
+        for (int z = 0; z < 4; z++)
         {
-            float v_pos = (float)cos(_radians) *
-                              (y - _center.y) +
-                          sin(_radians) * (x - _center.x) + _center.y;
-            float h_pos = (float)-sin(_radians) *
-                              (y - _center.y) +
-                          cos(_radians) * (x - _center.x) + _center.x;
-
-            for (int z = 0; z < 4; z++)
+            float *out = row.writable(channel[z]);
+            for (int x = xx; x < r; x++)
             {
-                float *out = row.writable(channel[z]);
-                out[x] = (sin(atan2(h_pos - _center.x, v_pos - _center.y) * _amount)) * _color[z];
+                out[x] = values[x - xx] * _color[z];
             }
         }
     };
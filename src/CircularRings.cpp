@@ -11,6 +11,9 @@ static const char *const HELP = "Radial distributed rings.\n\n"
 #include "DDImage/DDMath.h"
 #include <math.h>
 
+#include "NukularMath.h"
+#include "RowCache.h"
+
 using namespace DD::Image;
 using namespace std;
 
@@ -26,6 +29,8 @@ class CircularRings : public Iop
 
     double _radians;
 
+    nukular::RowCache _cache;
+
 public:
     const char *Class() const { return CLASS; }
     const char *node_help() const { return HELP; }
@@ -65,17 +70,21 @@ public:
         info_.set(format());
 
         _radians = M_PI / 180;
+        _cache.validate({_size}, _center.x, _center.y, true, info_.w(), info_.h());
     }
 
     void engine(int y, int xx, int r, ChannelMask channels, Row &row)
     {
-        for (int x = xx; x < r; x++)
+        nukular::RowCache::Span values = _cache.row(y, xx, r, [this](double dx, double dy) {
+            return float(nukular::rings<double>(dx, dy, _size));
+        });
+
+        for (int z = 0; z < 4; z++)
         {
-            for (int z = 0; z < 4; z++)
+            float *out = row.writable(channel[z]);
+            for (int x = xx; x < r; x++)
             {
-                float *out = row.writable(channel[z]);
-                out[x] = (sin(sqrt((x - _center.x) * (x - _center.x) + (y - _center.y) * (y - _center.y)) / _size)) * _color[z];
-                ;
+                out[x] = values[x - xx] * _color[z];
             }
         }
     };
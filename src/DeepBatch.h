@@ -0,0 +1,76 @@
+/*
+ * DeepBatch.h
+ * Row batches of deep samples.
+ *
+ * The deep color nodes gather one channel of all samples of a row into a
+ * contiguous batch, run the same span kernels as their flat versions on it
+ * and write the batches back per pixel.
+ *
+ */
+
+#ifndef NUKULAR_DEEP_BATCH_H
+#define NUKULAR_DEEP_BATCH_H
+
+#include "DDImage/DeepPlane.h"
+#include "DDImage/RGB.h"
+
+#include <vector>
+
+namespace nukular
+{
+
+// Number of samples in row y.
+inline size_t sample_count(DD::Image::DeepPlane &plane, int y, const DD::Image::Box &box)
+{
+    size_t count = 0;
+    for (int x = box.x(); x < box.r(); x++)
+        count += plane.getPixel(y, x).getSampleCount();
+    return count;
+}
+
+// Copies channel z of all samples in row y into values.
+inline void gather(DD::Image::DeepPlane &plane, int y, const DD::Image::Box &box, DD::Image::Channel z,
+                   std::vector<float> &values, size_t count)
+{
+    values.resize(count);
+    size_t i = 0;
+    for (int x = box.x(); x < box.r(); x++)
+    {
+        DD::Image::DeepPixel pixel = plane.getPixel(y, x);
+        for (size_t s = 0; s < pixel.getSampleCount(); s++)
+            values[i++] = pixel.getUnorderedSample(s, z);
+    }
+}
+
+// Adds row y to out. Channels in batched come from batch[colourIndex(z)],
+// all others are copied from plane.
+inline void write_row(DD::Image::DeepPlane &plane, int y, const DD::Image::Box &box,
+                      const DD::Image::ChannelSet &channels, const DD::Image::ChannelSet &batched,
+                      const std::vector<float> batch[3], DD::Image::DeepOutputPlane &out)
+{
+    using namespace DD::Image;
+    size_t offset = 0;
+    for (int x = box.x(); x < box.r(); x++)
+    {
+        DeepPixel pixel = plane.getPixel(y, x);
+        const size_t samples = pixel.getSampleCount();
+        DeepOutPixel values;
+        values.reserve(samples * channels.size());
+        for (size_t s = 0; s < samples; s++)
+        {
+            foreach (z, channels)
+            {
+                if (batched & z)
+                    values.push_back(batch[colourIndex(z)][offset + s]);
+                else
+                    values.push_back(pixel.getUnorderedSample(s, z));
+            }
+        }
+        offset += samples;
+        out.addPixel(values);
+    }
+}
+
+} // namespace nukular
+
+#endif // NUKULAR_DEEP_BATCH_H
@@ -0,0 +1,109 @@
+static const char *const CLASS = "DeepKontrast";
+static const char *const HELP = "Deep version of Kontrast. Adjusts the contrast of every deep sample around a pivot, "
+                                "matching the flat Kontrast node.\n\n"
+                                "Version: 1.0.0";
+
+#include "DDImage/DeepFilterOp.h"
+#include "DDImage/Knobs.h"
+#include "DDImage/RGB.h"
+
+#include <vector>
+
+#include "DeepBatch.h"
+#include "NukularMath.h"
+
+using namespace DD::Image;
+
+class DeepKontrast : public DeepFilterOp
+{
+    float _value[4];
+    double _pivot;
+    bool _unpremult;
+
+public:
+    DeepKontrast(Node *node) : DeepFilterOp(node)
+    {
+        _value[0] = _value[1] = _value[2] = _value[3] = 1.0;
+        _pivot = 0.18f;
+        _unpremult = true;
+    }
+
+    void knobs(Knob_Callback f) override;
+
+    void getDeepRequests(Box box, const ChannelSet &channels, int count, std::vector<RequestData> &requests) override
+    {
+        ChannelSet needed = channels;
+        if (_unpremult)
+            needed += Chan_Alpha;
+        requests.push_back(RequestData(input0(), box, needed, count));
+    }
+
+    bool doDeepEngine(Box box, const ChannelSet &channels, DeepOutputPlane &plane) override;
+    static const Op::Description d;
+
+    const char *Class() const override { return CLASS; }
+    const char *node_help() const override { return HELP; }
+};
+
+void DeepKontrast::knobs(Knob_Callback f)
+{
+    AColor_knob(f, _value, IRange(0, 5), "value", "value");
+    Tooltip(f, "Contrast value to \nin- or decreae contrast of the image.");
+    Double_knob(f, &_pivot, IRange(0, 1), "pivot", "pivot");
+    Tooltip(f, "The pivot for the contrast enhancement. 0.18 is default and matches the ColorCorrection behavior.");
+    Bool_knob(f, &_unpremult, "unpremult", "unpremult");
+    SetFlags(f, Knob::STARTLINE);
+    Tooltip(f, "Divide every sample by its alpha before adjusting the contrast and multiply it again afterwards, "
+               "so partly transparent samples are graded like opaque ones.");
+}
+
+bool DeepKontrast::doDeepEngine(Box box, const ChannelSet &channels, DeepOutputPlane &plane)
+{
+    DeepOp *in = input0();
+    if (!in)
+        return true;
+
+    ChannelSet rgb = channels;
+    rgb &= Mask_RGB;
+    const bool unpremult = _unpremult && !rgb.empty();
+    ChannelSet needed = channels;
+    if (unpremult)
+        needed += Chan_Alpha;
+
+    DeepPlane inPlane;
+    if (!in->deepEngine(box, needed, inPlane))
+        return false;
+
+    DeepOutputPlane outPlane(channels, box);
+
+    // The samples of each channel of a row are processed as one contiguous
+    // batch, then written back per pixel.
+    std::vector<float> batch[3], alpha;
+    for (int y = box.y(); y < box.t(); y++)
+    {
+        const size_t count = nukular::sample_count(inPlane, y, box);
+        if (unpremult)
+        {
+            nukular::gather(inPlane, y, box, Chan_Alpha, alpha, count);
+        }
+
+        foreach (z, rgb)
+        {
+            std::vector<float> &values = batch[colourIndex(z)];
+            nukular::gather(inPlane, y, box, z, values, count);
+            if (unpremult)
+                nukular::unpremult_span(values.data(), alpha.data(), count);
+            nukular::kontrast_span(values.data(), values.data(), count, double(_value[colourIndex(z)]), _pivot);
+            if (unpremult)
+                nukular::premult_span(values.data(), alpha.data(), count);
+        }
+
+        nukular::write_row(inPlane, y, box, channels, rgb, batch, outPlane);
+    }
+
+    plane = outPlane;
+    return true;
+}
+
+static Op *build(Node *node) { return new DeepKontrast(node); }
+const Op::Description DeepKontrast::d(CLASS, 0, build);
@@ -0,0 +1,124 @@
+static const char *const CLASS = "DeepVibrant";
+static const char *const HELP = "Deep version of Vibrant. Adds colorfulness to less saturated deep samples.\n\n"
+                                "Version: 1.0.0";
+
+#include "DDImage/DeepFilterOp.h"
+#include "DDImage/Knobs.h"
+#include "DDImage/RGB.h"
+
+#include <vector>
+
+#include "DeepBatch.h"
+#include "NukularMath.h"
+
+using namespace DD::Image;
+
+static const char *mode_names[] = {
+    "Rec 709", "Ccir 601", "Average", "Maximum", nullptr};
+
+class DeepVibrant : public DeepFilterOp
+{
+  double _vibrant;
+  int mode;
+  bool _unpremult;
+
+public:
+  DeepVibrant(Node *node) : DeepFilterOp(node)
+  {
+    _vibrant = 1.0;
+    mode = 0;
+    _unpremult = true;
+  }
+
+  void knobs(Knob_Callback f) override;
+
+  void getDeepRequests(Box box, const ChannelSet &channels, int count, std::vector<RequestData> &requests) override
+  {
+    ChannelSet needed = channels;
+    needed += Mask_RGB;
+    if (_unpremult)
+      needed += Chan_Alpha;
+    requests.push_back(RequestData(input0(), box, needed, count));
+  }
+
+  bool doDeepEngine(Box box, const ChannelSet &channels, DeepOutputPlane &plane) override;
+  static const Op::Description d;
+
+  const char *Class() const override { return CLASS; }
+  const char *node_help() const override { return HELP; }
+};
+
+void DeepVibrant::knobs(Knob_Callback f)
+{
+  Double_knob(f, &_vibrant, IRange(0, 5), "vibrancy", "Vibrancy");
+  Tooltip(f, "Adjust the amount of colorfulness. A value of 1 does not change the image.\n"
+             "Values higher than 1 will add more color to less saturated areas, while Vibrancy values lower than "
+             " 1 will reduce color of saturated areas");
+  Enumeration_knob(f, &mode, mode_names, "mode", "luminance math");
+  Tooltip(f, "Choose a mode to apply the greyscale conversion.");
+  Bool_knob(f, &_unpremult, "unpremult", "unpremult");
+  SetFlags(f, Knob::STARTLINE);
+  Tooltip(f, "Divide every sample by its alpha before adding colorfulness and multiply it again afterwards, "
+             "so partly transparent samples are graded like opaque ones.");
+}
+
+bool DeepVibrant::doDeepEngine(Box box, const ChannelSet &channels, DeepOutputPlane &plane)
+{
+  DeepOp *in = input0();
+  if (!in)
+    return true;
+
+  ChannelSet rgb = channels;
+  rgb &= Mask_RGB;
+  const bool process = !rgb.empty() && _vibrant != 1.0;
+  const bool unpremult = process && _unpremult;
+  ChannelSet needed = channels;
+  if (process)
+    needed += Mask_RGB;
+  if (unpremult)
+    needed += Chan_Alpha;
+
+  DeepPlane inPlane;
+  if (!in->deepEngine(box, needed, inPlane))
+    return false;
+
+  DeepOutputPlane outPlane(channels, box);
+
+  // The samples of a row are gathered into one contiguous batch per color
+  // channel, processed at once, then written back per pixel.
+  std::vector<float> batch[3], alpha;
+  for (int y = box.y(); y < box.t(); y++)
+  {
+    if (process)
+    {
+      const size_t count = nukular::sample_count(inPlane, y, box);
+      for (int c = 0; c < 3; c++)
+        nukular::gather(inPlane, y, box, Channel(Chan_Red + c), batch[c], count);
+      if (unpremult)
+      {
+        nukular::gather(inPlane, y, box, Chan_Alpha, alpha, count);
+        for (int c = 0; c < 3; c++)
+          nukular::unpremult_span(batch[c].data(), alpha.data(), count);
+      }
+
+      float *r = batch[0].data();
+      float *g = batch[1].data();
+      float *b = batch[2].data();
+      nukular::vibrant_span(mode, float(_vibrant), r, g, b, r, g, b, count);
+
+      if (unpremult)
+      {
+        for (int c = 0; c < 3; c++)
+          nukular::premult_span(batch[c].data(), alpha.data(), count);
+      }
+    }
+
+    nukular::write_row(inPlane, y, box, channels, process ? rgb : ChannelSet(), batch, outPlane);
+  }
+
+  plane = outPlane;
+  return true;
+}
+
+static Op *build(Node *node) { return new DeepVibrant(node); }
+const Op::Description DeepVibrant::d(CLASS, 0, build);
@@ -6,20 +6,22 @@ static const char *const HELP = "Lightweight contrast node to match by default t
 #include "DDImage/PixelIop.h"
 #include "DDImage/Row.h"
 #include "DDImage/Knobs.h"
-#include "DDImage/NukeWrapper.h"
 #include "DDImage/DDMath.h"
 #include "DDImage/RGB.h"
 
+#include "MaskedPixelIop.h"
+#include "NukularMath.h"
+
 using namespace DD::Image;
 
-class Kontrast : public PixelIop
+class Kontrast : public nukular::MaskedPixelIop
 {
 
     float _value[4];
     double _pivot;
 
 public:
-    Kontrast(Node *node) : PixelIop(node)
+    Kontrast(Node *node) : MaskedPixelIop(node)
     {
         _value[0] = _value[1] = _value[2] = _value[3] = 1.0;
         _pivot = 0.18f;
@@ -31,6 +33,7 @@ public:
     void _validate(bool for_real) override
     {
         copy_info();
+        validate_mask(for_real);
         for (unsigned i = 0; i < 4; i++)
         {
             if (_value[i])
@@ -52,10 +55,12 @@ public:
 
 void Kontrast::knobs(Knob_Callback f)
 {
+    channel_knobs(f);
     AColor_knob(f, _value, IRange(0, 5), "value", "value");
     Tooltip(f, "Contrast value to \nin- or decreae contrast of the image.");
     Double_knob(f, &_pivot, IRange(0, 1), "pivot", "pivot");
     Tooltip(f, "The pivot for the contrast enhancement. 0.18 is default and matches the ColorCorrection behavior.");
+    mask_knobs(f);
 }
 
 void Kontrast::pixel_engine(const Row &in, int y, int x, int r,
@@ -63,16 +68,12 @@ void Kontrast::pixel_engine(const Row &in, int y, int x, int r,
 {
     foreach (z, channels)
     {
-        const float c1 = _value[colourIndex(z)];
+        const double c1 = _value[colourIndex(z)];
         const float *inptr = in[z] + x;
-        const float *END = inptr + (r - x);
         float *outptr = out.writable(z) + x;
-        while (inptr < END)
-        {
-            *outptr++ = pow(*inptr++ / _pivot, c1) * _pivot;
-        }
+        nukular::kontrast_span(inptr, outptr, size_t(r - x), c1, _pivot);
     }
 }
 
-static Iop *build(Node *node) { return (new NukeWrapper(new Kontrast(node)))->channels(Mask_RGB); }
+static Iop *build(Node *node) { return new Kontrast(node); }
 const Iop::Description Kontrast::d("Kontrast", 0, build);
\ No newline at end of file
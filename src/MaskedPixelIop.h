@@ -0,0 +1,281 @@
+/*
+ * MaskedPixelIop.h
+ * PixelIop with its own channels, mask, unpremult and mix.
+ *
+ * NukeWrapper calls pixel_engine() of the op it wraps for every pixel and
+ * only blends with its mask afterwards. This base class replaces it: it reads
+ * the mask row first, calls pixel_engine() only on spans where the mask and
+ * mix are not zero and copies the input everywhere else. A mask input is only
+ * requested inside its bounding box.
+ *
+ * Like NukeWrapper the mask is taken from the mask input when it is
+ * connected and from a channel of the main input otherwise. All knobs keep
+ * the names NukeWrapper gave them, so scripts saved with the wrapped nodes
+ * keep loading with their settings. Subclasses are registered without
+ * NukeWrapper, call channel_knobs() first and mask_knobs() last in knobs(),
+ * and validate_mask() in _validate() once info_ is set.
+ *
+ */
+
+#ifndef NUKULAR_MASKED_PIXEL_IOP_H
+#define NUKULAR_MASKED_PIXEL_IOP_H
+
+#include "DDImage/PixelIop.h"
+#include "DDImage/Row.h"
+#include "DDImage/Knobs.h"
+#include "DDImage/DDMath.h"
+
+#include "NukularMath.h"
+
+namespace nukular
+{
+
+class MaskedPixelIop : public DD::Image::PixelIop
+{
+    DD::Image::ChannelSet _channels;
+    DD::Image::Channel _maskChannelMask, _maskChannelInput, _unpremult;
+    bool _inject, _invertMask, _fringe;
+    float _mix;
+
+    // Iop and channel the mask is read from, set by validate_mask().
+    DD::Image::Iop *_mask;
+    DD::Image::Channel _maskChannel;
+    DD::Image::Box _maskBox;
+
+protected:
+    MaskedPixelIop(DD::Image::Node *node) : PixelIop(node),
+                                            _channels(DD::Image::Mask_RGB),
+                                            _maskChannelMask(DD::Image::Chan_Black),
+                                            _maskChannelInput(DD::Image::Chan_Alpha),
+                                            _unpremult(DD::Image::Chan_Black),
+                                            _inject(false),
+                                            _invertMask(false),
+                                            _fringe(false),
+                                            _mix(1.0f),
+                                            _mask(nullptr),
+                                            _maskChannel(DD::Image::Chan_Black)
+    {
+    }
+
+    void channel_knobs(DD::Image::Knob_Callback f)
+    {
+        using namespace DD::Image;
+        Input_ChannelSet_knob(f, &_channels, 0, "channels");
+        Tooltip(f, "Channels to process, all others are passed through.");
+    }
+
+    void mask_knobs(DD::Image::Knob_Callback f)
+    {
+        using namespace DD::Image;
+        Divider(f);
+        Input_Channel_knob(f, &_maskChannelMask, 1, 0, "maskChannelMask", "mask");
+        Tooltip(f, "Channel of the input to limit the effect, used while the mask input is not connected. "
+                   "Pixels outside the mask are not processed.");
+        Input_Channel_knob(f, &_maskChannelInput, 1, 1, "maskChannelInput", "mask input");
+        Tooltip(f, "Channel of the mask input to limit the effect. Pixels outside the mask are not processed.");
+        Bool_knob(f, &_inject, "inject", "inject");
+        Tooltip(f, "Copy the mask to mask.a, to use it again further down the tree.");
+        Bool_knob(f, &_invertMask, "invert_mask", "invert");
+        Tooltip(f, "Invert the mask.");
+        Bool_knob(f, &_fringe, "fringe", "fringe");
+        Tooltip(f, "Only apply the effect to the soft edge of the mask, not to where it is fully on.");
+        Channel_knob(f, &_unpremult, 1, "unpremult", "(un)premult by");
+        SetFlags(f, Knob::STARTLINE);
+        Tooltip(f, "Divide the channels by this one before processing them and multiply them again afterwards.");
+        Float_knob(f, &_mix, IRange(0, 1), "mix");
+        Tooltip(f, "Blend between the input, at 0, and the full effect, at 1.");
+    }
+
+    // Call from _validate() once info_ is set.
+    void validate_mask(bool for_real)
+    {
+        using namespace DD::Image;
+        _mask = nullptr;
+        Iop *maskInput = input(1);
+        bool blackOutside = true;
+        if (maskInput && _maskChannelInput != Chan_Black)
+        {
+            maskInput->validate(for_real);
+            _mask = maskInput;
+            _maskChannel = _maskChannelInput;
+            _maskBox = maskInput->info();
+            blackOutside = maskInput->info().black_outside();
+        }
+        else if (_maskChannelMask != Chan_Black && (info_.channels() & _maskChannelMask))
+        {
+            _mask = &input0();
+            _maskChannel = _maskChannelMask;
+            _maskBox = info_;
+        }
+
+        if (!_mask)
+            return;
+
+        // Outside its bounding box the mask is zero when it is black
+        // outside. Inverted it is one there, unless only the fringe counts.
+        if ((_invertMask && !_fringe) || !blackOutside)
+            _maskBox = info_;
+
+        if (_inject)
+            info_.turn_on(Chan_Mask);
+    }
+
+    void _request(int x, int y, int r, int t, DD::Image::ChannelMask channels, int count) override
+    {
+        using namespace DD::Image;
+        ChannelSet needed = channels;
+        if (_mask && _mask == &input0())
+            needed += _maskChannel;
+        if (_unpremult != Chan_Black)
+            needed += _unpremult;
+        PixelIop::_request(x, y, r, t, needed, count);
+        if (!_mask || _mask == &input0())
+            return;
+
+        Box box(x, y, r, t);
+        box.intersect(_maskBox);
+        if (box.w() > 0 && box.h() > 0)
+            _mask->request(box.x(), box.y(), box.r(), box.t(), ChannelSet(_maskChannel), count);
+    }
+
+    void engine(int y, int x, int r, DD::Image::ChannelMask channels, DD::Image::Row &out) override
+    {
+        using namespace DD::Image;
+        const bool fromInput = _mask && _mask == &input0();
+        const bool unpremult = _unpremult != Chan_Black;
+        ChannelSet needed = channels;
+        in_channels(0, needed);
+        if (fromInput)
+            needed += _maskChannel;
+        if (unpremult)
+            needed += _unpremult;
+        Row in(x, r);
+        in.get(input0(), y, x, r, needed);
+        if (aborted())
+            return;
+        out.copy(in, channels, x, r);
+
+        // Mask values on [mx, mr), zero everywhere else. Without a mask every
+        // pixel is processed.
+        int mx = x, mr = r;
+        bool inside = true;
+        const float *maskValues = nullptr;
+        Row maskRow(x, r);
+        if (_mask)
+        {
+            mx = MAX(x, _maskBox.x());
+            mr = MIN(r, _maskBox.r());
+            inside = y >= _maskBox.y() && y < _maskBox.t() && mx < mr;
+            if (inside && fromInput)
+            {
+                maskValues = in[_maskChannel];
+            }
+            else if (inside)
+            {
+                maskRow.get(*_mask, y, mx, mr, ChannelSet(_maskChannel));
+                if (aborted())
+                    return;
+                maskValues = maskRow[_maskChannel];
+            }
+        }
+
+        ChannelSet active = channels;
+        active &= _channels;
+        active &= out_channels();
+        if (_inject)
+            active -= Chan_Mask;
+
+        // pixel_engine() reads the unpremultiplied input, all channels it
+        // needs are divided except the one divided by.
+        Row divided(x, r);
+        const Row *src = &in;
+        const float *alpha = unpremult ? in[_unpremult] : nullptr;
+        ChannelSet dividedChannels = needed;
+        if (unpremult && inside && !active.empty())
+        {
+            dividedChannels -= _unpremult;
+            divided.copy(in, needed, x, r);
+            foreach (z, dividedChannels)
+                unpremult_span(divided.writable(z) + mx, alpha + mx, size_t(mr - mx));
+            src = &divided;
+        }
+
+        for (int i = mx; inside && !active.empty() && i < mr;)
+        {
+            while (i < mr && weight(maskValues, i) == 0.0f)
+                i++;
+            const int from = i;
+            while (i < mr && weight(maskValues, i) != 0.0f)
+                i++;
+            if (from == i)
+                continue;
+
+            pixel_engine(*src, y, from, i, active, out);
+            foreach (z, active)
+            {
+                const float *inptr = in[z];
+                float *outptr = out.writable(z);
+                if (unpremult && z != _unpremult)
+                    premult_span(outptr + from, alpha + from, size_t(i - from));
+                for (int p = from; p < i; p++)
+                {
+                    const float w = weight(maskValues, p);
+                    if (w < 1.0f)
+                        outptr[p] = lerp(inptr[p], outptr[p], w);
+                }
+            }
+        }
+
+        // pixel_engine() may write channels it reads, like the other colors
+        // of Vibrant, which are passed through when they are not processed.
+        ChannelSet passed = channels;
+        passed -= active;
+        out.copy(in, passed, x, r);
+
+        if (_inject && (channels & Chan_Mask))
+        {
+            float *injected = out.writable(Chan_Mask);
+            for (int p = x; p < r; p++)
+                injected[p] = maskValues && p >= mx && p < mr ? maskValues[p] : 0.0f;
+        }
+    }
+
+private:
+    // Blend weight of pixel i, from the mask value if there is a mask.
+    float weight(const float *maskValues, int i) const
+    {
+        if (!_mask)
+            return DD::Image::clamp(_mix);
+        float m = DD::Image::clamp(maskValues[i]);
+        if (_invertMask)
+            m = 1.0f - m;
+        if (_fringe)
+            m = 4.0f * m * (1.0f - m);
+        return m * DD::Image::clamp(_mix);
+    }
+
+public:
+    int minimum_inputs() const override { return 1; }
+    int maximum_inputs() const override { return 2; }
+
+    const char *input_label(int n, char *) const override
+    {
+        return n == 1 ? "mask" : nullptr;
+    }
+
+    Op *default_input(int n) const override
+    {
+        return n == 1 ? nullptr : PixelIop::default_input(n);
+    }
+
+    bool test_input(int n, Op *op) const override
+    {
+        if (n == 1)
+            return dynamic_cast<DD::Image::Iop *>(op) != nullptr;
+        return PixelIop::test_input(n, op);
+    }
+};
+
+} // namespace nukular
+
+#endif // NUKULAR_MASKED_PIXEL_IOP_H
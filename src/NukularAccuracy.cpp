@@ -0,0 +1,620 @@
+/*
+ * NukularAccuracy.cpp
+ * Accuracy test for the Nukular kernels.
+ *
+ * Runs the code paths the plugins use, the cached and mirrored rows of the
+ * draw nodes, the Kontrast and Vibrant spans and the Scroll wrap, next to
+ * their double precision reference. Prints the error per kernel and variant
+ * and fails if any of them exceeds its limit, so optimized builds can be
+ * checked with ctest.
+ *
+ * Relative and ulp errors are taken against max(|reference|, floor), so
+ * results close to a zero crossing are judged by their absolute error.
+ *
+ * Clarity ships as a Blink kernel, Clarity.blink, which is not run here.
+ * Only its C++ port nukular::clarity() is checked, against a bound derived
+ * from its operations.
+ *
+ */
+
+static const char *const HELP =
+    "Usage:\n"
+    "  nukular-accuracy [--samples n] [--seed n]\n";
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "NukularMath.h"
+#include "RowCache.h"
+
+using namespace std;
+
+static const char *mode_names[] = {
+    "rec709", "ccir601", "average", "maximum", nullptr};
+
+static const float nan_value = numeric_limits<float>::quiet_NaN();
+static const float inf_value = numeric_limits<float>::infinity();
+
+class Error
+{
+    const char *_kernel, *_variant;
+    double _floor, _max_abs, _max_ulp;
+    double _abs, _rel, _ulp, _bound;
+    long _samples, _mismatches;
+
+    // Distance between v and the next float.
+    static double spacing(double v)
+    {
+        float f = float(v);
+        return double(nextafter(f, inf_value)) - double(f);
+    }
+
+public:
+    // floor is the smallest magnitude relative and ulp errors are taken
+    // against, max_abs and max_ulp the limits of the kernel.
+    Error(const char *kernel, const char *variant, double floor, double max_abs, double max_ulp)
+        : _kernel(kernel), _variant(variant), _floor(floor), _max_abs(max_abs), _max_ulp(max_ulp),
+          _abs(0), _rel(0), _ulp(0), _bound(0), _samples(0), _mismatches(0)
+    {
+    }
+
+    // bound is the largest absolute error allowed for this sample, a negative
+    // bound only checks the limits of the kernel.
+    void add(float value, double reference, double bound = -1)
+    {
+        _samples++;
+        if (isnan(value) || isnan(reference))
+        {
+            if (isnan(value) != isnan(reference))
+                _mismatches++;
+            return;
+        }
+        if (isinf(value) || isinf(reference) || isinf(float(reference)))
+        {
+            if (value != float(reference))
+                _mismatches++;
+            return;
+        }
+        double abs_err = fabs(double(value) - reference);
+        double magnitude = max(fabs(reference), _floor);
+        _abs = max(_abs, abs_err);
+        _rel = max(_rel, abs_err / magnitude);
+        _ulp = max(_ulp, abs_err / spacing(magnitude));
+        if (bound >= 0)
+            _bound = max(_bound, abs_err <= bound ? abs_err / max(bound, 1e-300) : inf_value);
+    }
+
+    // Counts values that have to be identical, like the same pixel
+    // processed in different spans.
+    void same(float a, float b)
+    {
+        _samples++;
+        if (memcmp(&a, &b, sizeof(float)) != 0 && !(isnan(a) && isnan(b)))
+            _mismatches++;
+    }
+
+    static void header()
+    {
+        printf("%-14s %-16s %9s %12s %12s %10s %8s %8s\n", "kernel", "variant", "samples", "max abs", "max rel",
+               "max ulp", "bound", "nan/inf");
+    }
+
+    bool report() const
+    {
+        bool ok = _mismatches == 0 && _abs <= _max_abs && _ulp <= _max_ulp && _bound <= 1;
+        printf("%-14s %-16s %9ld %12.4g %12.4g %10.1f %8.3f %8ld  %s\n", _kernel, _variant, _samples, _abs, _rel,
+               _ulp, _bound, _mismatches, ok ? "ok" : "FAILED");
+        return ok;
+    }
+};
+
+class Samples
+{
+    mt19937 _rng;
+    uniform_real_distribution<float> _unit;
+
+public:
+    explicit Samples(unsigned seed) : _rng(seed), _unit(0.0f, 1.0f) {}
+
+    float range(float a, float b) { return a + (b - a) * _unit(_rng); }
+    int integer(int a, int b) { return a + int(_rng() % unsigned(b - a + 1)); }
+
+    // Colors covering negatives, zero, HDR values, infinity and NaN.
+    float color(long i)
+    {
+        static const float edges[] = {0.0f, -0.0f, 1.0f, 0.18f, -0.5f, -1.0f, 1e-6f, 16.0f, 1000.0f, 65504.0f,
+                                      inf_value, nan_value};
+        switch (i % 4)
+        {
+        case 0:
+            return edges[size_t(i / 4) % (sizeof(edges) / sizeof(edges[0]))];
+        case 1:
+            return range(-1.0f, 0.0f);
+        case 2:
+            return range(0.0f, 1.0f);
+        default:
+            return range(1.0f, 1000.0f);
+        }
+    }
+
+    // Center of the draw nodes, on a pixel, between two pixels or anywhere.
+    float center(int size)
+    {
+        switch (integer(0, 3))
+        {
+        case 0:
+            return float(size / 2);
+        case 1:
+            return float(size / 2) + 0.5f;
+        case 2:
+            return range(-0.5f * size, 1.5f * size);
+        default:
+            return float(integer(-size, 2 * size)) + range(0.0f, 1.0f);
+        }
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Draw nodes. Rows are requested through the RowCache in random order and
+// windows, like Nuke does from several threads, including a center moved by
+// whole pixels and a budget small enough to drop the cache.
+// ---------------------------------------------------------------------------
+
+template <typename Field, typename Reference>
+static void check_draw(Error &error, Samples &samples, long trials, bool symmetric,
+                       Field field, Reference reference)
+{
+    for (long trial = 0; trial < trials; trial++)
+    {
+        const int width = samples.integer(1, 8192);
+        const int height = samples.integer(1, 4320);
+        float cx = samples.center(width);
+        float cy = samples.center(height);
+        // A small budget drops rows, also of symmetric fields, which are
+        // otherwise sized from the frame.
+        const bool small = samples.integer(0, 2) == 0;
+        const size_t budget = small ? size_t(width) * 4 : nukular::RowCache::default_budget;
+        const vector<double> key = {double(trial)};
+
+        nukular::RowCache cache(budget);
+        for (int pass = 0; pass < 3; pass++)
+        {
+            if (pass == 2)
+            {
+                cx += float(samples.integer(-16, 16));
+                cy += float(samples.integer(-16, 16));
+            }
+            cache.validate(key, cx, cy, symmetric, small ? 0 : width, small ? 0 : height);
+            for (int request = 0; request < 16; request++)
+            {
+                int y = samples.integer(0, height - 1);
+                if (request % 4 == 1)
+                    y = int(floor(2.0f * cy)) - y;
+                int x = samples.integer(-64, width - 1);
+                int r = samples.integer(x + 1, min(x + 1024, width + 64));
+                nukular::RowCache::Span values = cache.row(y, x, r, field);
+                for (int i = x; i < r; i++)
+                    error.add(values[i - x], reference(double(i) - cx, double(y) - cy));
+            }
+        }
+    }
+}
+
+static bool check_draw_nodes(Samples &samples, long trials)
+{
+    bool ok = true;
+
+    // The fields stay within [-1, 1] and are only scaled by the colors, so
+    // their error is taken against 1. Circle runs in float like it always
+    // did. At its edge pow() of a value close to zero amplifies any rounding
+    // of the distance, so its reference starts from the distance the float
+    // kernel computes and checks the falloff after it.
+    Error circle("Circle", "-", 1, 1e-6, 8);
+    Error ramp("CircularRamp", "-", 1, 1e-6, 8);
+    Error rays("CircularRays", "-", 1, 1e-7, 1);
+    Error rings("CircularRings", "-", 1, 1e-7, 1);
+    for (long trial = 0; trial < trials; trial++)
+    {
+        // Knobs as the plugins store them.
+        const float size = trial % 7 == 0 ? 1.0f : samples.range(1.0f, 500.0f);
+        const float falloff = trial % 11 == 0 ? 0.0f : samples.range(0.1f, 5.0f);
+        const double amount = samples.range(1.0f, 500.0f);
+        const double radians = samples.range(0.0f, 360.0f) * nukular::Constants<double>::radians;
+
+        const float exponent = nukular::circle_exponent(falloff);
+        const double exponent_d = nukular::circle_exponent<double>(falloff);
+        check_draw(circle, samples, 1, true, [&](float dx, float dy) {
+            return nukular::circle(dx, dy, size, exponent);
+        }, [&](double dx, double dy) {
+            const float fdx = float(dx), fdy = float(dy);
+            const double d = (size - double(sqrt(fdx * fdx + fdy * fdy))) / size;
+            return pow(d > 0.0 ? d : 0.0, exponent_d);
+        });
+
+        const float cos_f = float(cos(radians)), sin_f = float(sin(radians));
+        check_draw(ramp, samples, 1, false, [&](float dx, float dy) {
+            return nukular::ramp(dx, dy, cos_f, sin_f);
+        }, [&](double dx, double dy) {
+            return nukular::ramp<double>(dx, dy, cos(radians), sin(radians));
+        });
+
+        check_draw(rays, samples, 1, false, [&](double dx, double dy) {
+            return float(nukular::rays<double>(dx, dy, cos(radians), sin(radians), amount));
+        }, [&](double dx, double dy) {
+            return nukular::rays<double>(dx, dy, cos(radians), sin(radians), amount);
+        });
+
+        check_draw(rings, samples, 1, true, [&](double dx, double dy) {
+            return float(nukular::rings<double>(dx, dy, size));
+        }, [&](double dx, double dy) {
+            return nukular::rings<double>(dx, dy, size);
+        });
+    }
+    ok &= circle.report();
+    ok &= ramp.report();
+    ok &= rays.report();
+    ok &= rings.report();
+    return ok;
+}
+
+// A centred symmetric field evaluates about a quarter of the frame, the
+// mirrored half of every row and the mirrored rows are copied. Checked for
+// full frames rendered bottom to top and top to bottom.
+static bool check_row_cache_reuse()
+{
+    static const int formats[][2] = {{1920, 1080}, {3840, 2160}, {8192, 4320}};
+    const double limit = 0.26;
+    bool ok = true;
+    for (const auto &format : formats)
+    {
+        const int width = format[0], height = format[1];
+        double worst = 0;
+        for (int order = 0; order < 2; order++)
+        {
+            long evaluated = 0;
+            nukular::RowCache cache;
+            cache.validate({0.0}, width / 2, height / 2, true, width, height);
+            for (int i = 0; i < height; i++)
+            {
+                const int y = order == 0 ? i : height - 1 - i;
+                cache.row(y, 0, width, [&](double, double) {
+                    evaluated++;
+                    return 0.0f;
+                });
+            }
+            worst = max(worst, double(evaluated) / (double(width) * height));
+        }
+        char variant[32];
+        snprintf(variant, sizeof(variant), "%dx%d", width, height);
+        const bool passed = worst <= limit;
+        printf("%-14s %-16s %9ld %12s %12s %10s %8s %8s  %s, %.3f of the pixels evaluated\n", "RowCache", variant,
+               long(width) * height, "-", "-", "-", "-", "-", passed ? "ok" : "FAILED", worst);
+        ok &= passed;
+    }
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Color nodes, run as spans of random length like the rows of Kontrast,
+// Vibrant and the batches of their deep versions.
+// ---------------------------------------------------------------------------
+
+static bool check_kontrast(Samples &samples, long count)
+{
+    Error error("Kontrast", "span", 1e-3, inf_value, 1);
+    Error zero("Kontrast", "pivot 0", 1e-3, inf_value, 1);
+    Error deep("Kontrast", "unpremult", 1e-3, inf_value, 8);
+    vector<float> in, out, alpha;
+    for (long done = 0; done < count;)
+    {
+        const size_t n = size_t(samples.integer(1, 2048));
+        const double value = done % 5 == 0 ? 1.0 : samples.range(0.0f, 5.0f);
+        const double pivot = samples.range(0.01f, 1.0f);
+        in.resize(n);
+        out.resize(n);
+        alpha.resize(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            in[i] = samples.color(done + long(i));
+            alpha[i] = i % 8 == 0 ? 0.0f : samples.range(0.0f, 1.0f);
+        }
+
+        nukular::kontrast_span(in.data(), out.data(), n, value, pivot);
+        for (size_t i = 0; i < n; i++)
+            error.add(out[i], nukular::kontrast<double>(in[i], value, pivot));
+
+        // A pivot of 0 divides by zero. A pow() that returns 0 or inf where
+        // the reference gives NaN shows up as a nan/inf mismatch.
+        nukular::kontrast_span(in.data(), out.data(), n, value, 0.0);
+        for (size_t i = 0; i < n; i++)
+            zero.add(out[i], nukular::kontrast<double>(in[i], value, 0.0));
+
+        // Premultiplied samples as DeepKontrast grades them.
+        for (size_t i = 0; i < n; i++)
+            out[i] = in[i] * alpha[i];
+        nukular::unpremult_span(out.data(), alpha.data(), n);
+        nukular::kontrast_span(out.data(), out.data(), n, value, pivot);
+        nukular::premult_span(out.data(), alpha.data(), n);
+        for (size_t i = 0; i < n; i++)
+        {
+            const double premult = double(in[i] * alpha[i]);
+            if (alpha[i] == 0.0f)
+                deep.add(out[i], nukular::kontrast<double>(premult, value, pivot));
+            else
+                deep.add(out[i], nukular::kontrast<double>(premult / alpha[i], value, pivot) * alpha[i]);
+        }
+        done += long(n);
+    }
+    bool ok = error.report();
+    ok &= zero.report();
+    ok &= deep.report();
+    return ok;
+}
+
+static bool check_vibrant(Samples &samples, long count)
+{
+    bool ok = true;
+    for (int mode = 0; mode_names[mode]; mode++)
+    {
+        // The mask of Vibrant is zero outside of [0, 1], the error is taken
+        // against 1.
+        Error error("Vibrant", mode_names[mode], 1, 2e-6, 16);
+        const string label = string("offset ") + mode_names[mode];
+        Error offset("Vibrant", label.c_str(), 0, 0, 0);
+
+        vector<float> rgb[3], out[3], shifted[3];
+        for (long done = 0; done < count;)
+        {
+            const size_t n = size_t(samples.integer(1, 2048));
+            const float vib = done % 5 == 0 ? 1.0f : samples.range(0.0f, 5.0f);
+            for (int c = 0; c < 3; c++)
+            {
+                rgb[c].resize(n);
+                out[c].resize(n);
+            }
+
+            // Runs of saturated and achromatic pixels, which are skipped,
+            // between random colors.
+            for (size_t i = 0; i < n;)
+            {
+                const size_t run = min(n - i, size_t(samples.integer(1, 150)));
+                const int kind = samples.integer(0, 2);
+                const float grey = samples.range(0.0f, 1.0f);
+                for (size_t j = i; j < i + run; j++)
+                {
+                    for (int c = 0; c < 3; c++)
+                    {
+                        if (kind == 0)
+                            rgb[c][j] = samples.color(done + long(j * 3) + c);
+                        else if (kind == 1)
+                            rgb[c][j] = c == 0 ? 1.0f : 0.0f;
+                        else
+                            rgb[c][j] = grey;
+                    }
+                }
+                i += run;
+            }
+
+            nukular::vibrant_span(mode, vib, rgb[0].data(), rgb[1].data(), rgb[2].data(),
+                                  out[0].data(), out[1].data(), out[2].data(), n);
+            for (size_t i = 0; i < n; i++)
+            {
+                double r = rgb[0][i], g = rgb[1][i], b = rgb[2][i];
+                nukular::vibrant<double>(mode, vib, r, g, b);
+                error.add(out[0][i], r);
+                error.add(out[1][i], g);
+                error.add(out[2][i], b);
+            }
+
+            // A pixel has to give the same result wherever its span starts,
+            // also when working in place.
+            const size_t start = size_t(samples.integer(0, int(n) - 1));
+            for (int c = 0; c < 3; c++)
+                shifted[c].assign(rgb[c].begin() + start, rgb[c].end());
+            nukular::vibrant_span(mode, vib, shifted[0].data(), shifted[1].data(), shifted[2].data(),
+                                  shifted[0].data(), shifted[1].data(), shifted[2].data(), n - start);
+            for (size_t i = start; i < n; i++)
+                for (int c = 0; c < 3; c++)
+                    offset.same(shifted[c][i - start], out[c][i]);
+
+            done += long(n);
+        }
+        ok &= error.report();
+        ok &= offset.report();
+    }
+    return ok;
+}
+
+// Bound on the error of clarity<float>, following its operations in order.
+// Every float operation adds at most u times the magnitude of its result,
+// errors of the operands are carried through with the magnitude of what
+// they are multiplied by.
+template <typename Sampler>
+static void clarity_bound(const Sampler &src, int x, int y, const double contrast[4], double pivot, int scale,
+                          double bound[4])
+{
+    const double u = ldexp(1.0, -24);
+    const double n = double((2 * scale + 1) * (2 * scale + 1));
+
+    // Blur. The float weights are off by at most 6u each.
+    double sum[4] = {0, 0, 0, 0}, sum_abs[4] = {0, 0, 0, 0}, src_abs[4] = {0, 0, 0, 0};
+    double normaliser = 0;
+    for (int X = -scale; X <= scale; X++)
+    {
+        for (int Y = -scale; Y <= scale; Y++)
+        {
+            double w = max(double(scale) - sqrt(double(X * X + Y * Y)), 0.0) / scale;
+            for (int c = 0; c < 4; c++)
+            {
+                const double v = src(x + X, y + Y, c);
+                sum[c] += v * w;
+                sum_abs[c] += fabs(v) * w;
+                src_abs[c] += fabs(v);
+            }
+            normaliser += w;
+        }
+    }
+    const double normaliser_err = 6 * u * n + n * u * normaliser;
+
+    double centre[4], blur[4], blur_err[4];
+    for (int c = 0; c < 4; c++)
+    {
+        centre[c] = src(x, y, c);
+        blur[c] = sum[c] / normaliser;
+        const double sum_err = 6 * u * src_abs[c] + n * u * sum_abs[c];
+        blur_err[c] = sum_err / normaliser + fabs(blur[c]) * normaliser_err / normaliser + u * fabs(blur[c]);
+    }
+
+    // The mask is the largest difference, off by at most the largest error.
+    double mask = -inf_value, mask_err = 0;
+    for (int c = 0; c < 3; c++)
+    {
+        mask = max(mask, centre[c] - blur[c]);
+        mask_err = max(mask_err, blur_err[c] + u * (fabs(centre[c]) + fabs(blur[c])));
+    }
+
+    // kontrast() divides, raises to the contrast and multiplies, pow() adds
+    // the relative error of its base times the exponent.
+    double out[4], out_err[4];
+    for (int c = 0; c < 4; c++)
+    {
+        const double k = nukular::kontrast(centre[c], contrast[c], pivot);
+        const double k_err = (fabs(contrast[c]) + 4) * u * fabs(k);
+        out[c] = (1 - mask) * centre[c] + mask * k;
+        out_err[c] = mask_err * (fabs(centre[c]) + fabs(k)) + fabs(mask) * k_err +
+                     4 * u * (fabs(1 - mask) * fabs(centre[c]) + fabs(mask) * fabs(k));
+    }
+
+    const double average = (contrast[0] + contrast[1] + contrast[2]) / 3;
+    const double saturation = (average - 1) * 0.1 + 1;
+    const double saturation_err = 8 * u * (fabs(average) + 1);
+    const double coefficient[3] = {0.2126, 0.7152, 0.0722};
+    double y_out = 0, y_err = 0;
+    for (int c = 0; c < 3; c++)
+    {
+        y_out += out[c] * coefficient[c];
+        y_err += coefficient[c] * (out_err[c] + 4 * u * fabs(out[c]));
+    }
+
+    for (int c = 0; c < 4; c++)
+    {
+        const double diff = fabs(out[c] - y_out);
+        bound[c] = (out_err[c] + y_err) * fabs(saturation) + diff * saturation_err + y_err +
+                   4 * u * (diff + fabs(y_out)) * (fabs(saturation) + 1);
+        // Margin for the bound itself, and for denormal results.
+        bound[c] = 2 * bound[c] + ldexp(1.0, -140);
+    }
+}
+
+static bool check_clarity(Samples &samples, long count)
+{
+    // Clarity.blink itself is not run, see the top of the file. The port
+    // has to stay within the error its float operations can cause, which is
+    // large where the saturation step subtracts the luma of contrasted HDR
+    // values.
+    Error error("Clarity", "port", 1, inf_value, inf_value);
+    Error zero("Clarity", "port pivot 0", 1, inf_value, inf_value);
+    const int tile = 16;
+    vector<float> image(tile * tile * 4);
+    for (long i = 0; i < count; i++)
+    {
+        // Every color spreads to the whole tile through the blur, so edge
+        // colors are only placed in some of them.
+        for (size_t p = 0; p < image.size(); p++)
+            image[p] = samples.range(-1.0f, 16.0f);
+        if (i % 8 == 0)
+            image[size_t(samples.integer(0, int(image.size()) - 1))] = samples.color(i / 8 * 4);
+        auto sampler = [&](int x, int y, int c) {
+            x = min(max(x, 0), tile - 1);
+            y = min(max(y, 0), tile - 1);
+            return image[(y * tile + x) * 4 + c];
+        };
+        float contrast[4];
+        double contrast_d[4];
+        for (int c = 0; c < 4; c++)
+            contrast_d[c] = contrast[c] = samples.range(0.0f, 5.0f);
+        const bool pivot_zero = i % 8 == 4;
+        float pivot = pivot_zero ? 0.0f : samples.range(0.01f, 1.0f);
+        int scale = 1 + int(i % 5);
+        float out[4];
+        double ref[4], bound[4];
+        nukular::clarity(sampler, tile / 2, tile / 2, contrast, pivot, scale, out);
+        nukular::clarity<double>(sampler, tile / 2, tile / 2, contrast_d, pivot, scale, ref);
+        clarity_bound(sampler, tile / 2, tile / 2, contrast_d, pivot, scale, bound);
+        for (int c = 0; c < 4; c++)
+            (pivot_zero ? zero : error).add(out[c], ref[c], bound[c]);
+    }
+    bool ok = error.report();
+    ok &= zero.report();
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Scroll. Every output pixel has to come from the source pixel at its
+// position minus the shift, wrapped with floor division.
+// ---------------------------------------------------------------------------
+
+static bool check_scroll(Samples &samples, long count)
+{
+    Error error("Scroll", "wrap", 0, 0, 0);
+    vector<float> src, out;
+    for (long done = 0; done < count;)
+    {
+        const int width = samples.integer(1, 300);
+        const int shift = samples.integer(-5000, 5000);
+        const int x = samples.integer(-2000, 2000);
+        const int r = samples.integer(x, x + 2000);
+        src.resize(width);
+        for (int i = 0; i < width; i++)
+            src[i] = float(i);
+        out.assign(size_t(r - x), -1.0f);
+
+        nukular::wrap_row(src.data(), width, shift, out.data() - x, x, r);
+        for (int i = x; i < r; i++)
+        {
+            const long p = long(i) - shift;
+            const long expected = p - long(width) * long(floor(double(p) / width));
+            error.same(out[i - x], float(expected));
+            error.same(float(nukular::wrap(int(p), width)), float(expected));
+        }
+        done += max(r - x, 1);
+    }
+    return error.report();
+}
+
+int main(int argc, char **argv)
+{
+    long samples = 200000;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--samples") && i + 1 < argc)
+            samples = atol(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+            seed = unsigned(atol(argv[++i]));
+        else
+        {
+            fputs(HELP, stderr);
+            return 2;
+        }
+    }
+
+    Samples random(seed);
+    bool ok = true;
+    Error::header();
+    ok &= check_draw_nodes(random, max(samples / 20000, 1L));
+    ok &= check_row_cache_reuse();
+    ok &= check_kontrast(random, samples);
+    ok &= check_vibrant(random, samples);
+    ok &= check_clarity(random, max(samples / 1000, 1L));
+    ok &= check_scroll(random, samples);
+    return ok ? 0 : 1;
+}
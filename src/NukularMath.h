@@ -0,0 +1,385 @@
+/*
+ * NukularMath.h
+ * Per-pixel math shared by the Nukular plugins.
+ *
+ * Every function is templated on the scalar type. The plugins instantiate
+ * them with the precision they always computed in, double instantiations
+ * serve as the reference for checking the error of faster code paths.
+ * Nothing in here depends on DDImage.
+ *
+ */
+
+#ifndef NUKULAR_MATH_H
+#define NUKULAR_MATH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace nukular
+{
+
+template <typename T>
+struct Constants
+{
+    static constexpr T pi = T(3.14159265358979323846);
+    static constexpr T two_pi = T(6.28318530717958647692);
+    static constexpr T radians = T(3.14159265358979323846 / 180.0);
+};
+
+template <typename T>
+inline T clamp01(T v)
+{
+    return v < T(0) ? T(0) : (v > T(1) ? T(1) : v);
+}
+
+template <typename T>
+inline T lerp(T a, T b, T t)
+{
+    return a + (b - a) * t;
+}
+
+// ---------------------------------------------------------------------------
+// Draw nodes. All fields are evaluated relative to the node center, dx and dy
+// being the pixel position minus the center.
+// ---------------------------------------------------------------------------
+
+// Circle falloff knob to the exponent used by circle().
+template <typename T>
+inline T circle_exponent(T falloff)
+{
+    return (falloff != T(0)) ? T(1) / falloff : T(0.00000001);
+}
+
+template <typename T>
+inline T circle(T dx, T dy, T size, T exponent)
+{
+    T d = (size - std::sqrt(dx * dx + dy * dy)) / size;
+    return std::pow(d > T(0) ? d : T(0), exponent);
+}
+
+template <typename T>
+inline T rings(T dx, T dy, T size)
+{
+    return std::sin(std::sqrt(dx * dx + dy * dy) / size);
+}
+
+// Angle of the rotated position around the center, in the range [-pi, pi].
+template <typename T>
+inline T rotated_angle(T dx, T dy, T cos_r, T sin_r)
+{
+    T h = -sin_r * dy + cos_r * dx;
+    T v = cos_r * dy + sin_r * dx;
+    return std::atan2(h, v);
+}
+
+// Position along the CircularRamp in the range [0, 1].
+template <typename T>
+inline T ramp(T dx, T dy, T cos_r, T sin_r)
+{
+    return T(0.5) + rotated_angle(dx, dy, cos_r, sin_r) / Constants<T>::two_pi;
+}
+
+template <typename T>
+inline T ramp_color(T t, T start, T end)
+{
+    return start + (end - start) * t;
+}
+
+template <typename T>
+inline T rays(T dx, T dy, T cos_r, T sin_r, T amount)
+{
+    return std::sin(rotated_angle(dx, dy, cos_r, sin_r) * amount);
+}
+
+// ---------------------------------------------------------------------------
+// Color nodes.
+// ---------------------------------------------------------------------------
+
+template <typename T>
+inline T kontrast(T v, T value, T pivot)
+{
+    return std::pow(v / pivot, value) * pivot;
+}
+
+// kontrast() over n contiguous values, in and out may be the same. The math
+// runs in T, which may be wider than the stored values V.
+template <typename T, typename V>
+inline void kontrast_span(const V *in, V *out, size_t n, T value, T pivot)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i] = V(kontrast(T(in[i]), value, pivot));
+    }
+}
+
+// Divides n values by their alpha, values with a zero alpha are kept.
+template <typename T>
+inline void unpremult_span(T *values, const T *alpha, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        values[i] = alpha[i] != T(0) ? values[i] / alpha[i] : values[i];
+    }
+}
+
+// Inverse of unpremult_span().
+template <typename T>
+inline void premult_span(T *values, const T *alpha, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        values[i] = alpha[i] != T(0) ? values[i] * alpha[i] : values[i];
+    }
+}
+
+enum LumaMode
+{
+    REC709 = 0,
+    CCIR601,
+    AVERAGE,
+    MAXIMUM
+};
+
+template <typename T>
+inline T y_convert_rec709(T r, T g, T b)
+{
+    return r * T(0.2125) + g * T(0.7154) + b * T(0.0721);
+}
+
+template <typename T>
+inline T y_convert_ccir601(T r, T g, T b)
+{
+    return r * T(0.299) + g * T(0.587) + b * T(0.114);
+}
+
+template <typename T>
+inline T y_convert_avg(T r, T g, T b)
+{
+    return (r + g + b) / T(3);
+}
+
+template <typename T>
+inline T y_convert_max(T r, T g, T b)
+{
+    if (g > r)
+        r = g;
+    if (b > r)
+        r = b;
+    return r;
+}
+
+template <typename T>
+inline T y_convert_min(T r, T g, T b)
+{
+    if (g < r)
+        r = g;
+    if (b < r)
+        r = b;
+    return r;
+}
+
+template <typename T>
+inline T luma(int mode, T r, T g, T b)
+{
+    switch (mode)
+    {
+    case CCIR601:
+        return y_convert_ccir601(r, g, b);
+    case AVERAGE:
+        return y_convert_avg(r, g, b);
+    case MAXIMUM:
+        return y_convert_max(r, g, b);
+    default:
+        return y_convert_rec709(r, g, b);
+    }
+}
+
+// Weight of the vibrancy, zero for highly saturated pixels.
+template <typename T>
+inline T vibrant_mask(T r, T g, T b)
+{
+    T mn = y_convert_min(r, g, b);
+    T mx = y_convert_max(r, g, b);
+    T s = T(1) - (mx - mn);
+    return clamp01(T(1) - (mx > s ? mx : s));
+}
+
+template <typename T>
+inline T vibrant_blend(T y, T c, T vib, T m)
+{
+    return (lerp(y, c, vib) * m) + ((T(1) - m) * c);
+}
+
+// Pixels with a zero mask keep their value exactly, also when it is not
+// finite, so skipping them gives the same result as processing them.
+template <typename T>
+inline T vibrant_value(T y, T c, T vib, T m)
+{
+    return m == T(0) ? c : vibrant_blend(y, c, vib, m);
+}
+
+template <typename T>
+inline void vibrant(int mode, T vib, T &r, T &g, T &b)
+{
+    T y = luma(mode, r, g, b);
+    T m = vibrant_mask(r, g, b);
+    r = vibrant_value(y, r, vib, m);
+    g = vibrant_value(y, g, vib, m);
+    b = vibrant_value(y, b, vib, m);
+}
+
+// vibrant_value() over n contiguous values of one channel, using tmp for n
+// values. The blend and the select run as separate loops, so both vectorize.
+template <typename T>
+inline void vibrant_channel(const T *y, const T *m, const T *in, T *out, T vib, T *tmp, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        tmp[i] = vibrant_blend(y[i], in[i], vib, m[i]);
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i] = m[i] == T(0) ? in[i] : tmp[i];
+    }
+}
+
+template <int Mode, typename T>
+inline void vibrant_span(T vib, const T *rIn, const T *gIn, const T *bIn, T *rOut, T *gOut, T *bOut, size_t n)
+{
+    // Luma and mask of a block are computed up front, so every loop only
+    // writes a single array and vectorizes, also when working in place.
+    const size_t block = 256;
+    const size_t chunk = 64;
+    T y[block], m[block], tmp[chunk];
+    for (size_t start = 0; start < n; start += block)
+    {
+        const size_t count = std::min(block, n - start);
+        const T *r = rIn + start, *g = gIn + start, *b = bIn + start;
+        for (size_t i = 0; i < count; i++)
+        {
+            y[i] = luma(Mode, r[i], g[i], b[i]);
+            m[i] = vibrant_mask(r[i], g[i], b[i]);
+        }
+
+        // Saturated and achromatic pixels have a zero mask and keep their
+        // value, chunks without any other pixel are copied through.
+        for (size_t from = 0; from < count; from += chunk)
+        {
+            const size_t to = std::min(from + chunk, count);
+            bool active = false;
+            for (size_t i = from; i < to; i++)
+                active |= m[i] != T(0);
+
+            if (active)
+            {
+                vibrant_channel(y + from, m + from, r + from, rOut + start + from, vib, tmp, to - from);
+                vibrant_channel(y + from, m + from, g + from, gOut + start + from, vib, tmp, to - from);
+                vibrant_channel(y + from, m + from, b + from, bOut + start + from, vib, tmp, to - from);
+            }
+            else if (rOut != rIn)
+            {
+                std::copy(r + from, r + to, rOut + start + from);
+                std::copy(g + from, g + to, gOut + start + from);
+                std::copy(b + from, b + to, bOut + start + from);
+            }
+        }
+    }
+}
+
+// vibrant() over n contiguous values per channel, inputs and outputs may be
+// the same. The mode is resolved once per span instead of per pixel.
+template <typename T>
+inline void vibrant_span(int mode, T vib, const T *rIn, const T *gIn, const T *bIn, T *rOut, T *gOut, T *bOut, size_t n)
+{
+    switch (mode)
+    {
+    case CCIR601:
+        vibrant_span<CCIR601>(vib, rIn, gIn, bIn, rOut, gOut, bOut, n);
+        break;
+    case AVERAGE:
+        vibrant_span<AVERAGE>(vib, rIn, gIn, bIn, rOut, gOut, bOut, n);
+        break;
+    case MAXIMUM:
+        vibrant_span<MAXIMUM>(vib, rIn, gIn, bIn, rOut, gOut, bOut, n);
+        break;
+    default:
+        vibrant_span<REC709>(vib, rIn, gIn, bIn, rOut, gOut, bOut, n);
+        break;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Scroll.
+// ---------------------------------------------------------------------------
+
+// coord wrapped into [0, total).
+inline int wrap(int coord, int total)
+{
+    coord %= total;
+    if (coord < 0)
+    {
+        coord += total;
+    }
+    return coord;
+}
+
+// Fills out[x, r) with the row src[0, width) shifted by shift pixels and
+// repeated, copying in runs up to the next wrap around.
+template <typename T>
+inline void wrap_row(const T *src, int width, int shift, T *out, int x, int r)
+{
+    for (int i = x; i < r;)
+    {
+        const int from = wrap(i - shift, width);
+        const int run = std::min(r - i, width - from);
+        std::copy(src + from, src + from + run, out + i);
+        i += run;
+    }
+}
+
+// Clarity, mirroring src/Clarity.blink. src(x, y, c) has to return the edge
+// clamped input for channel c, the result for (x, y) is written to out.
+template <typename T, typename Sampler>
+inline void clarity(const Sampler &src, int x, int y, const T contrast[4], T pivot, int scale, T out[4])
+{
+    T blur[4] = {T(0), T(0), T(0), T(0)};
+    T normaliser = T(0);
+    for (int X = -scale; X <= scale; X++)
+    {
+        for (int Y = -scale; Y <= scale; Y++)
+        {
+            T w = T(scale) - std::sqrt(T(X * X + Y * Y));
+            w = (w > T(0) ? w : T(0)) / T(scale);
+            for (int c = 0; c < 4; c++)
+            {
+                blur[c] += T(src(x + X, y + Y, c)) * w;
+            }
+            normaliser += w;
+        }
+    }
+
+    T centre[4];
+    for (int c = 0; c < 4; c++)
+    {
+        centre[c] = T(src(x, y, c));
+        blur[c] /= normaliser;
+    }
+
+    T mask = y_convert_max(centre[0] - blur[0], centre[1] - blur[1], centre[2] - blur[2]);
+    for (int c = 0; c < 4; c++)
+    {
+        out[c] = ((T(1) - mask) * centre[c]) + mask * kontrast(centre[c], contrast[c], pivot);
+    }
+
+    T saturation = ((((contrast[0] + contrast[1] + contrast[2]) / T(3)) - T(1)) * T(0.1)) + T(1);
+    T y_out = out[0] * T(0.2126) + out[1] * T(0.7152) + out[2] * T(0.0722);
+    for (int c = 0; c < 4; c++)
+    {
+        out[c] = (out[c] - y_out) * saturation + y_out;
+    }
+}
+
+} // namespace nukular
+
+#endif // NUKULAR_MATH_H
@@ -0,0 +1,624 @@
+/*
+ * NukularRender.cpp
+ * Headless renderer for the Nukular draw and color nodes.
+ *
+ * Renders Circle, CircularRamp, CircularRays, CircularRings, Kontrast and
+ * Vibrant outside of Nuke, using the same kernels as the plugins. Rows are
+ * rendered on all cores and written to disk as soon as they are finished,
+ * so only one row per thread is held in memory.
+ *
+ */
+
+static const char *const HELP =
+    "Usage:\n"
+    "  nukular-render <node> [knobs] [options] -o <output>\n"
+    "\n"
+    "Nodes:\n"
+    "  Circle         --center x y  --size s  --falloff f  --color r g b a\n"
+    "  CircularRamp   --center x y  --rotate deg  --start_color r g b a  --end_color r g b a\n"
+    "  CircularRays   --center x y  --amount n  --rotate deg  --color r g b a\n"
+    "  CircularRings  --center x y  --size s  --color r g b a\n"
+    "  Kontrast       --input in.pfm  --value r g b a  --pivot p\n"
+    "  Vibrant        --input in.pfm  --vibrancy v  --mode rec709|ccir601|average|maximum\n"
+    "\n"
+    "Options:\n"
+    "  -o, --output path   .pfm writes RGB PFM, any other extension raw RGBA float32.\n"
+    "                      Rows are stored bottom to top like in Nuke.\n"
+    "  --format w h        Output format of the draw nodes, default 1920 1080.\n"
+    "  --frames first last Renders a range, input and output paths take a %d or\n"
+    "                      %0Nd for the frame number, e.g. ramp.%04d.pfm.\n"
+    "  --threads n         Number of threads, default all cores.\n"
+    "  --reference         Renders with the double precision kernels.\n"
+    "\n"
+    "Version: 1.0.0\n";
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "NukularMath.h"
+#include "RowCache.h"
+
+using namespace std;
+
+typedef map<string, vector<double>> Knobs;
+
+static const char *mode_names[] = {
+    "rec709", "ccir601", "average", "maximum", nullptr};
+
+static double knob(const Knobs &knobs, const char *name, double fallback, size_t index = 0)
+{
+    Knobs::const_iterator it = knobs.find(name);
+    if (it == knobs.end() || it->second.empty())
+        return fallback;
+    // A single value sets all components, like in Nuke.
+    return it->second[min(index, it->second.size() - 1)];
+}
+
+// Options every node takes, and the knobs of each node, with the number of
+// values they take. Colors also take a single value for all components.
+struct Option
+{
+    const char *name;
+    size_t min, max;
+};
+
+static const Option render_options[] = {
+    {"format", 2, 2}, {"frames", 2, 2}, {"threads", 1, 1}, {"reference", 0, 0}, {nullptr, 0, 0}};
+
+static const struct
+{
+    const char *node;
+    Option knobs[5];
+} node_knobs[] = {
+    {"Circle", {{"center", 2, 2}, {"size", 1, 1}, {"falloff", 1, 1}, {"color", 1, 4}, {nullptr, 0, 0}}},
+    {"CircularRamp", {{"center", 2, 2}, {"rotate", 1, 1}, {"start_color", 1, 4}, {"end_color", 1, 4}, {nullptr, 0, 0}}},
+    {"CircularRays", {{"center", 2, 2}, {"amount", 1, 1}, {"rotate", 1, 1}, {"color", 1, 4}, {nullptr, 0, 0}}},
+    {"CircularRings", {{"center", 2, 2}, {"size", 1, 1}, {"color", 1, 4}, {nullptr, 0, 0}}},
+    {"Kontrast", {{"value", 1, 4}, {"pivot", 1, 1}, {nullptr, 0, 0}}},
+    {"Vibrant", {{"vibrancy", 1, 1}, {"mode", 1, 1}, {nullptr, 0, 0}}},
+};
+
+static const Option *find_option(const Option *options, const string &name)
+{
+    for (; options->name; options++)
+        if (name == options->name)
+            return options;
+    return nullptr;
+}
+
+// Throws unless every knob is one the node or the renderer takes, with a
+// valid number of values.
+static void check_knobs(const string &node, const Knobs &knobs)
+{
+    const Option *options = nullptr;
+    for (const auto &entry : node_knobs)
+        if (node == entry.node)
+            options = entry.knobs;
+    if (!options)
+        throw runtime_error("Unknown node " + node);
+
+    for (const auto &k : knobs)
+    {
+        const Option *option = find_option(options, k.first);
+        if (!option)
+            option = find_option(render_options, k.first);
+        if (!option)
+            throw runtime_error("Unknown option --" + k.first + " for " + node);
+
+        const size_t n = k.second.size();
+        if (n < option->min || n > option->max)
+        {
+            string expected = to_string(option->min);
+            if (option->max != option->min)
+                expected += " to " + to_string(option->max);
+            throw runtime_error("--" + k.first + " takes " + expected + " value(s), got " + to_string(n));
+        }
+    }
+}
+
+// Whole number knob, throws when it has a fraction.
+static int integer(const Knobs &knobs, const char *name, int fallback, size_t index = 0)
+{
+    double v = knob(knobs, name, fallback, index);
+    if (v != floor(v) || fabs(v) > 1e9)
+        throw runtime_error(string("--") + name + " takes whole numbers");
+    return int(v);
+}
+
+static bool little_endian()
+{
+    const uint32_t one = 1;
+    unsigned char first;
+    memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+// Replaces the single %d or %0Nd in pattern with the frame number. The
+// pattern is never passed to printf, any other % is an error.
+static string frame_path(const string &pattern, int frame)
+{
+    size_t at = pattern.find('%');
+    if (at == string::npos)
+        return pattern;
+
+    size_t end = at + 1;
+    while (end < pattern.size() && isdigit((unsigned char)pattern[end]))
+        end++;
+    string digits = pattern.substr(at + 1, end - at - 1);
+    if (end >= pattern.size() || pattern[end] != 'd' || pattern.find('%', end) != string::npos ||
+        digits.size() > 2 || (!digits.empty() && digits[0] != '0'))
+        throw runtime_error("Frame pattern needs a single %d or %0Nd: " + pattern);
+
+    char number[32];
+    snprintf(number, sizeof(number), "%0*d", digits.empty() ? 0 : atoi(digits.c_str()), frame);
+    return pattern.substr(0, at) + number + pattern.substr(end + 1);
+}
+
+// ---------------------------------------------------------------------------
+// File io. Rows are read and written at their offset, so threads can finish
+// them in any order.
+// ---------------------------------------------------------------------------
+
+class FrameReader
+{
+    mutex _lock;
+    ifstream _file;
+    streamoff _data;
+    int _width, _height, _channels;
+    bool _swap;
+
+public:
+    explicit FrameReader(const string &path) : _file(path.c_str(), ios::binary)
+    {
+        string magic;
+        double scale;
+        _file >> magic >> _width >> _height >> scale;
+        if (!_file || (magic != "PF" && magic != "Pf") || _width <= 0 || _height <= 0)
+            throw runtime_error("Can not read PFM file " + path);
+        _file.get();
+        _data = _file.tellg();
+        _channels = magic == "PF" ? 3 : 1;
+        _swap = (scale < 0) != little_endian();
+    }
+
+    int width() const { return _width; }
+    int height() const { return _height; }
+
+    // Reads row y as RGBA, alpha is 1.
+    void row(int y, float *rgba)
+    {
+        vector<float> values(size_t(_width) * _channels);
+        {
+            lock_guard<mutex> guard(_lock);
+            _file.seekg(_data + streamoff(y) * streamoff(values.size() * sizeof(float)));
+            _file.read(reinterpret_cast<char *>(values.data()), values.size() * sizeof(float));
+            if (!_file)
+                throw runtime_error("Unexpected end of PFM file");
+        }
+        if (_swap)
+        {
+            for (float &v : values)
+            {
+                char *b = reinterpret_cast<char *>(&v);
+                swap(b[0], b[3]);
+                swap(b[1], b[2]);
+            }
+        }
+        for (int x = 0; x < _width; x++)
+        {
+            for (int z = 0; z < 3; z++)
+                rgba[x * 4 + z] = values[x * _channels + (_channels == 3 ? z : 0)];
+            rgba[x * 4 + 3] = 1.0f;
+        }
+    }
+};
+
+class FrameWriter
+{
+    mutex _lock;
+    ofstream _file;
+    streamoff _data;
+    int _width, _channels;
+
+public:
+    FrameWriter(const string &path, int width, int height) : _file(path.c_str(), ios::binary | ios::trunc), _width(width)
+    {
+        if (!_file)
+            throw runtime_error("Can not write " + path);
+        bool pfm = path.size() >= 4 && path.compare(path.size() - 4, 4, ".pfm") == 0;
+        _channels = pfm ? 3 : 4;
+        if (pfm)
+            _file << "PF\n"
+                  << width << " " << height << "\n"
+                  << (little_endian() ? "-1.0" : "1.0") << "\n";
+        _data = _file.tellp();
+    }
+
+    // Writes row y from RGBA.
+    void row(int y, const float *rgba)
+    {
+        vector<float> values(size_t(_width) * _channels);
+        for (int x = 0; x < _width; x++)
+            for (int z = 0; z < _channels; z++)
+                values[x * _channels + z] = rgba[x * 4 + z];
+
+        lock_guard<mutex> guard(_lock);
+        _file.seekp(_data + streamoff(y) * streamoff(values.size() * sizeof(float)));
+        _file.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(float));
+        if (!_file)
+            throw runtime_error("Writing failed");
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Nodes. engine() fills one RGBA row of the given width, in is the matching
+// input row for the color nodes.
+// ---------------------------------------------------------------------------
+
+class Node
+{
+public:
+    virtual ~Node() {}
+    virtual bool has_input() const { return false; }
+    virtual void engine(int y, int width, const float *in, float *out) const = 0;
+};
+
+template <typename T>
+class Draw : public Node
+{
+protected:
+    float _cx, _cy;
+
+    Draw(const Knobs &knobs, int width, int height)
+    {
+        _cx = float(knob(knobs, "center", width / 2, 0));
+        _cy = float(knob(knobs, "center", height / 2, 1));
+    }
+
+    // Writes field values times color to out.
+    static void apply(const vector<T> &field, const T color[4], int width, float *out)
+    {
+        for (int x = 0; x < width; x++)
+            for (int z = 0; z < 4; z++)
+                out[x * 4 + z] = float(field[x] * color[z]);
+    }
+};
+
+template <typename T>
+class Circle : public Draw<T>
+{
+    T _size, _exponent, _color[4];
+
+public:
+    Circle(const Knobs &knobs, int width, int height) : Draw<T>(knobs, width, height)
+    {
+        _size = T(knob(knobs, "size", width / 4));
+        _exponent = nukular::circle_exponent(T(knob(knobs, "falloff", 1.0)));
+        for (int z = 0; z < 4; z++)
+            _color[z] = T(knob(knobs, "color", 1.0, z));
+    }
+
+    void engine(int y, int width, const float *, float *out) const override
+    {
+        vector<T> field(width);
+        const T dy = T(y) - T(this->_cy);
+        nukular::mirror_fill(field.data(), 0, width, this->_cx, [&](int x) {
+            return nukular::circle(T(x) - T(this->_cx), dy, _size, _exponent);
+        });
+        this->apply(field, _color, width, out);
+    }
+};
+
+template <typename T>
+class CircularRings : public Draw<T>
+{
+    T _size, _color[4];
+
+public:
+    CircularRings(const Knobs &knobs, int width, int height) : Draw<T>(knobs, width, height)
+    {
+        _size = T(knob(knobs, "size", 10.0));
+        for (int z = 0; z < 4; z++)
+            _color[z] = T(knob(knobs, "color", 1.0, z));
+    }
+
+    void engine(int y, int width, const float *, float *out) const override
+    {
+        vector<T> field(width);
+        const T dy = T(y) - T(this->_cy);
+        nukular::mirror_fill(field.data(), 0, width, this->_cx, [&](int x) {
+            return nukular::rings(T(x) - T(this->_cx), dy, _size);
+        });
+        this->apply(field, _color, width, out);
+    }
+};
+
+template <typename T>
+class CircularRays : public Draw<T>
+{
+    T _amount, _cos, _sin, _color[4];
+
+public:
+    CircularRays(const Knobs &knobs, int width, int height) : Draw<T>(knobs, width, height)
+    {
+        _amount = T(knob(knobs, "amount", 10.0));
+        double radians = knob(knobs, "rotate", 0.0) * nukular::Constants<double>::radians;
+        _cos = T(cos(radians));
+        _sin = T(sin(radians));
+        for (int z = 0; z < 4; z++)
+            _color[z] = T(knob(knobs, "color", 1.0, z));
+    }
+
+    void engine(int y, int width, const float *, float *out) const override
+    {
+        vector<T> field(width);
+        const T dy = T(y) - T(this->_cy);
+        for (int x = 0; x < width; x++)
+            field[x] = nukular::rays(T(x) - T(this->_cx), dy, _cos, _sin, _amount);
+        this->apply(field, _color, width, out);
+    }
+};
+
+template <typename T>
+class CircularRamp : public Draw<T>
+{
+    T _cos, _sin, _start[4], _end[4];
+
+public:
+    CircularRamp(const Knobs &knobs, int width, int height) : Draw<T>(knobs, width, height)
+    {
+        double radians = knob(knobs, "rotate", 0.0) * nukular::Constants<double>::radians;
+        _cos = T(cos(radians));
+        _sin = T(sin(radians));
+        for (int z = 0; z < 4; z++)
+        {
+            _start[z] = T(knob(knobs, "start_color", 0.0, z));
+            _end[z] = T(knob(knobs, "end_color", 1.0, z));
+        }
+    }
+
+    void engine(int y, int width, const float *, float *out) const override
+    {
+        const T dy = T(y) - T(this->_cy);
+        for (int x = 0; x < width; x++)
+        {
+            T t = nukular::ramp(T(x) - T(this->_cx), dy, _cos, _sin);
+            for (int z = 0; z < 4; z++)
+                out[x * 4 + z] = float(nukular::ramp_color(t, _start[z], _end[z]));
+        }
+    }
+};
+
+template <typename T>
+class Kontrast : public Node
+{
+    T _value[4], _pivot;
+
+public:
+    explicit Kontrast(const Knobs &knobs)
+    {
+        for (int z = 0; z < 4; z++)
+            _value[z] = T(knob(knobs, "value", 1.0, z));
+        _pivot = T(knob(knobs, "pivot", 0.18));
+    }
+
+    bool has_input() const override { return true; }
+
+    void engine(int, int width, const float *in, float *out) const override
+    {
+        for (int x = 0; x < width; x++)
+        {
+            for (int z = 0; z < 3; z++)
+                out[x * 4 + z] = float(nukular::kontrast(T(in[x * 4 + z]), _value[z], _pivot));
+            out[x * 4 + 3] = in[x * 4 + 3];
+        }
+    }
+};
+
+template <typename T>
+class Vibrant : public Node
+{
+    T _vibrant;
+    int _mode;
+    bool _copy;
+
+public:
+    explicit Vibrant(const Knobs &knobs)
+    {
+        _vibrant = T(knob(knobs, "vibrancy", 1.0));
+        _mode = int(knob(knobs, "mode", 0.0));
+        // Like the plugin, a vibrancy of exactly 1 copies the input.
+        _copy = knob(knobs, "vibrancy", 1.0) == 1.0;
+    }
+
+    bool has_input() const override { return true; }
+
+    void engine(int, int width, const float *in, float *out) const override
+    {
+        copy(in, in + size_t(width) * 4, out);
+        if (_copy)
+            return;
+
+        vector<T> rgb[3];
+        for (int z = 0; z < 3; z++)
+        {
+            rgb[z].resize(width);
+            for (int x = 0; x < width; x++)
+                rgb[z][x] = T(in[x * 4 + z]);
+        }
+        T *r = rgb[0].data(), *g = rgb[1].data(), *b = rgb[2].data();
+        nukular::vibrant_span(_mode, _vibrant, r, g, b, r, g, b, size_t(width));
+        for (int z = 0; z < 3; z++)
+            for (int x = 0; x < width; x++)
+                out[x * 4 + z] = float(rgb[z][x]);
+    }
+};
+
+template <typename T>
+static Node *create(const string &name, const Knobs &knobs, int width, int height)
+{
+    if (name == "Circle")
+        return new Circle<T>(knobs, width, height);
+    if (name == "CircularRamp")
+        return new CircularRamp<T>(knobs, width, height);
+    // Like in the plugins, these always compute in double.
+    if (name == "CircularRays")
+        return new CircularRays<double>(knobs, width, height);
+    if (name == "CircularRings")
+        return new CircularRings<double>(knobs, width, height);
+    if (name == "Kontrast")
+        return new Kontrast<double>(knobs);
+    if (name == "Vibrant")
+        return new Vibrant<T>(knobs);
+    throw runtime_error("Unknown node " + name);
+}
+
+// ---------------------------------------------------------------------------
+// Rendering.
+// ---------------------------------------------------------------------------
+
+static void render_frame(const Node &node, FrameReader *reader, FrameWriter &writer, int width, int height, int threads)
+{
+    atomic<int> next(0);
+    mutex error_lock;
+    string error;
+
+    auto work = [&]() {
+        try
+        {
+            vector<float> in(size_t(width) * 4), out(size_t(width) * 4);
+            for (int y = next++; y < height; y = next++)
+            {
+                if (reader)
+                    reader->row(y, in.data());
+                node.engine(y, width, in.data(), out.data());
+                writer.row(y, out.data());
+            }
+        }
+        catch (const exception &e)
+        {
+            lock_guard<mutex> guard(error_lock);
+            error = e.what();
+            next = height;
+        }
+    };
+
+    vector<thread> pool;
+    for (int i = 1; i < threads; i++)
+        pool.emplace_back(work);
+    work();
+    for (thread &t : pool)
+        t.join();
+
+    if (!error.empty())
+        throw runtime_error(error);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || !strcmp(argv[1], "-h") || !strcmp(argv[1], "--help"))
+    {
+        fputs(HELP, argc < 2 ? stderr : stdout);
+        return argc < 2 ? 1 : 0;
+    }
+
+    try
+    {
+        string node_name = argv[1];
+        string input, output;
+        Knobs knobs;
+        for (int i = 2; i < argc; i++)
+        {
+            string arg = argv[i];
+            if (arg.compare(0, 2, "--") != 0 && arg != "-o")
+                throw runtime_error("Unexpected argument " + arg);
+            string name = arg == "-o" ? "output" : arg.substr(2);
+            if (name == "output" || name == "input")
+            {
+                if (++i >= argc)
+                    throw runtime_error("Missing path for " + arg);
+                (name == "output" ? output : input) = argv[i];
+                continue;
+            }
+            vector<double> &values = knobs[name];
+            for (; i + 1 < argc; i++)
+            {
+                const char *value = argv[i + 1];
+                int mode = 0;
+                while (mode_names[mode] && strcmp(mode_names[mode], value))
+                    mode++;
+                if (mode_names[mode])
+                {
+                    values.push_back(mode);
+                    continue;
+                }
+                char *end;
+                double v = strtod(value, &end);
+                if (end == value || *end)
+                    break;
+                values.push_back(v);
+            }
+        }
+
+        check_knobs(node_name, knobs);
+        if (output.empty())
+            throw runtime_error("No output given, see --help");
+
+        int threads = integer(knobs, "threads", max(int(thread::hardware_concurrency()), 1));
+        int first = integer(knobs, "frames", 1, 0);
+        int last = integer(knobs, "frames", first, 1);
+        bool reference = knobs.count("reference") > 0;
+        if (threads <= 0)
+            throw runtime_error("--threads needs to be at least 1");
+        if (last < first)
+            throw runtime_error("--frames needs the first frame before the last");
+        if (last > first && output.find('%') == string::npos)
+            throw runtime_error("--frames needs a %d or %0Nd in the output path, every frame would overwrite " +
+                                output);
+
+        for (int frame = first; frame <= last; frame++)
+        {
+            unique_ptr<FrameReader> reader;
+            int width = integer(knobs, "format", 1920, 0);
+            int height = integer(knobs, "format", 1080, 1);
+            if (width <= 0 || height <= 0)
+                throw runtime_error("--format needs a width and height of at least 1");
+            if (!input.empty())
+            {
+                reader.reset(new FrameReader(frame_path(input, frame)));
+                width = reader->width();
+                height = reader->height();
+            }
+
+            unique_ptr<Node> node(reference ? create<double>(node_name, knobs, width, height)
+                                            : create<float>(node_name, knobs, width, height));
+            if (node->has_input() && !reader)
+                throw runtime_error(node_name + " needs an --input");
+
+            string path = frame_path(output, frame);
+            FrameWriter writer(path, width, height);
+            render_frame(*node, reader.get(), writer, width, height, threads);
+            printf("%s\n", path.c_str());
+        }
+    }
+    catch (const exception &e)
+    {
+        fprintf(stderr, "nukular-render: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
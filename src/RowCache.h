@@ -0,0 +1,299 @@
+/*
+ * RowCache.h
+ * Field cache for the draw nodes.
+ *
+ * The draw nodes evaluate a scalar field around their center and only scale
+ * it by their colors afterwards. Rows of the field are cached relative to the
+ * center and keyed on the geometric knobs, so color changes only redo the
+ * multiply-add and moving the center by whole pixels reuses the rows that
+ * were already computed.
+ *
+ * Fields that only depend on the distance to the center are mirror
+ * symmetric around center.x and center.y. For those each unique row is
+ * computed once, with its mirrored half copied instead of evaluated.
+ *
+ * All threads calling engine() share one cache. It holds a few MB, symmetric
+ * fields up to half the frame, so a row is still cached when its mirror is
+ * rendered. When full, rows whose mirror was already served are dropped
+ * first, then the rows farthest from the requested one.
+ *
+ */
+
+#ifndef NUKULAR_ROW_CACHE_H
+#define NUKULAR_ROW_CACHE_H
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace nukular
+{
+
+// Position mirrored around center, when 2 * center lands on a pixel.
+inline bool mirror_axis(float center, int &axis)
+{
+    float twice = center * 2.0f;
+    if (twice != std::floor(twice))
+        return false;
+    axis = int(twice);
+    return true;
+}
+
+// Writes fn(x) for [x, r) to out[0, r - x), copying every value whose mirror
+// around center was already computed.
+template <typename V, typename Fn>
+inline void mirror_fill(V *out, int x, int r, float center, Fn fn)
+{
+    int axis = 0;
+    bool mirrored = mirror_axis(center, axis);
+    for (int i = x; i < r; i++)
+    {
+        int m = axis - i;
+        if (mirrored && m < i && m >= x)
+            out[i - x] = out[m - x];
+        else
+            out[i - x] = fn(i);
+    }
+}
+
+class RowCache
+{
+public:
+    typedef std::shared_ptr<const std::vector<float>> Values;
+
+    // Field values of one row, starting at the requested x.
+    class Span
+    {
+        Values _values;
+        const float *_data;
+
+    public:
+        Span(const Values &values, size_t offset) : _values(values), _data(values->data() + offset) {}
+        float operator[](int i) const { return _data[i]; }
+    };
+
+private:
+    // A row covers the columns [a, a + values.size()) relative to the center.
+    // served has a bit for the row itself and one for its mirror, both are
+    // set for rows that have no mirror.
+    struct Entry
+    {
+        int a;
+        Values values;
+        unsigned served;
+    };
+
+    std::mutex _lock;
+    std::map<int, Entry> _rows;
+    size_t _size, _budget, _limit;
+    unsigned _generation;
+
+    std::vector<double> _key;
+    int _ix, _iy;
+    float _fx, _fy;
+    bool _symmetric;
+
+    // Canonical row for the relative row j.
+    static int canonical(int j, float fy, bool symmetric)
+    {
+        int axis = 0;
+        if (symmetric && j < fy && mirror_axis(fy, axis))
+            return axis - j;
+        return j;
+    }
+
+    // Bits of Entry::served.
+    enum
+    {
+        SERVED_ROW = 1,
+        SERVED_MIRROR = 2,
+        SERVED_ALL = 3
+    };
+
+    // Bit of Entry::served for row y, given its canonical row j.
+    unsigned served_bit(int y, int j) const
+    {
+        return y - _iy == j ? SERVED_ROW : SERVED_MIRROR;
+    }
+
+    // Bits to start a new row j with, rows without a mirror count as served
+    // on both sides.
+    static unsigned served_initial(int j, float fy, bool symmetric)
+    {
+        int axis = 0;
+        if (symmetric && mirror_axis(fy, axis) && axis - j != j)
+            return 0;
+        return SERVED_ALL;
+    }
+
+    // Drops rows until size more floats fit. Rows whose mirror was served go
+    // first, each time the one farthest from row j.
+    void evict(int j, size_t size)
+    {
+        while (!_rows.empty() && _size + size > _limit)
+        {
+            std::map<int, Entry>::iterator far = _rows.end();
+            for (std::map<int, Entry>::iterator it = _rows.begin(); it != _rows.end(); ++it)
+            {
+                if (it->second.served == SERVED_ALL &&
+                    (far == _rows.end() || std::abs(it->first - j) > std::abs(far->first - j)))
+                    far = it;
+            }
+            if (far == _rows.end())
+            {
+                std::map<int, Entry>::iterator first = _rows.begin();
+                std::map<int, Entry>::iterator last = std::prev(_rows.end());
+                far = j - first->first > last->first - j ? first : last;
+            }
+            _size -= far->second.values->size();
+            _rows.erase(far);
+        }
+    }
+
+public:
+    // Default budget, 4 MB of floats per node.
+    static const size_t default_budget = size_t(1) << 20;
+
+    // Largest budget of a symmetric field, 128 MB of floats per node.
+    static const size_t max_budget = size_t(1) << 25;
+
+    // budget is the maximum number of floats to keep.
+    explicit RowCache(size_t budget = default_budget)
+        : _size(0), _budget(budget), _limit(budget), _generation(0), _ix(0), _iy(0), _fx(0), _fy(0),
+          _symmetric(false)
+    {
+    }
+
+    // Keeps the cached rows if key and the subpixel position of the center
+    // are unchanged, drops them otherwise. width and height are the size of
+    // the rendered frame, symmetric fields keep up to half of it.
+    void validate(const std::vector<double> &key, float center_x, float center_y, bool symmetric, int width,
+                  int height)
+    {
+        int ix = int(std::floor(center_x));
+        int iy = int(std::floor(center_y));
+        float fx = center_x - ix;
+        float fy = center_y - iy;
+
+        std::lock_guard<std::mutex> guard(_lock);
+        if (key != _key || fx != _fx || fy != _fy || symmetric != _symmetric)
+        {
+            _rows.clear();
+            _size = 0;
+            _generation++;
+        }
+        _key = key;
+        _ix = ix;
+        _iy = iy;
+        _fx = fx;
+        _fy = fy;
+        _symmetric = symmetric;
+        _limit = _budget;
+        if (symmetric && width > 0 && height > 0)
+        {
+            const size_t half = size_t(width) * size_t(height / 2 + 1);
+            _limit = std::max(_budget, std::min(half, size_t(max_budget)));
+        }
+    }
+
+    // Returns the field for row y on [x, r). field(dx, dy) evaluates a single
+    // pixel relative to the center and is called without holding the lock.
+    // dx and dy are passed as double, which holds them exactly.
+    template <typename Field>
+    Span row(int y, int x, int r, Field field)
+    {
+        int j, a, b;
+        float fx, fy;
+        bool symmetric;
+        unsigned generation, bit;
+        Entry existing = {0, Values(), 0};
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            j = canonical(y - _iy, _fy, _symmetric);
+            a = x - _ix;
+            b = r - _ix;
+            fx = _fx;
+            fy = _fy;
+            symmetric = _symmetric;
+            generation = _generation;
+            bit = served_bit(y, j);
+
+            std::map<int, Entry>::iterator it = _rows.find(j);
+            if (it != _rows.end() && it->second.values)
+            {
+                it->second.served |= bit;
+                existing = it->second;
+                if (existing.a <= a && existing.a + int(existing.values->size()) >= b)
+                    return Span(existing.values, a - existing.a);
+            }
+        }
+
+        // Extend the existing row to cover [a, b), only computing what is
+        // missing.
+        int na = a, nb = b;
+        int ea = 0, eb = 0;
+        if (existing.values)
+        {
+            ea = existing.a;
+            eb = ea + int(existing.values->size());
+            na = std::min(na, ea);
+            nb = std::max(nb, eb);
+        }
+
+        std::shared_ptr<std::vector<float>> values(new std::vector<float>(nb - na));
+        const double dy = double(j) - fy;
+        auto fill = [&](int from, int to) {
+            auto fn = [&](int k) { return field(double(k) - fx, dy); };
+            float *out = values->data() + (from - na);
+            if (symmetric)
+                mirror_fill(out, from, to, fx, fn);
+            else
+                for (int k = from; k < to; k++)
+                    out[k - from] = fn(k);
+        };
+        if (existing.values)
+        {
+            std::copy(existing.values->begin(), existing.values->end(), values->begin() + (ea - na));
+            fill(na, ea);
+            fill(eb, nb);
+        }
+        else
+        {
+            fill(na, nb);
+        }
+
+        // Rows computed for a geometry that was dropped meanwhile are not
+        // stored, neither are rows another thread already extended further.
+        std::lock_guard<std::mutex> guard(_lock);
+        if (generation != _generation || values->size() > _limit)
+            return Span(values, a - na);
+        unsigned served = served_initial(j, fy, symmetric) | bit;
+        std::map<int, Entry>::iterator it = _rows.find(j);
+        if (it != _rows.end())
+        {
+            if (it->second.values->size() >= values->size())
+            {
+                it->second.served |= served;
+                return Span(values, a - na);
+            }
+            served |= it->second.served;
+            _size -= it->second.values->size();
+            _rows.erase(it);
+        }
+        evict(j, values->size());
+        Entry &entry = _rows[j];
+        entry.a = na;
+        entry.values = values;
+        entry.served = served;
+        _size += values->size();
+        return Span(values, a - na);
+    }
+};
+
+} // namespace nukular
+
+#endif // NUKULAR_ROW_CACHE_H
@@ -1,12 +1,18 @@
 #include "DDImage/Iop.h"
 #include "DDImage/Row.h"
-#include "DDImage/Pixel.h"
+#include "DDImage/Format.h"
 #include "DDImage/Knobs.h"
+#include "DDImage/DDMath.h"
+
+#include <math.h>
+
+#include "NukularMath.h"
 
 using namespace DD::Image;
 
 static const char *const CLASS = "Scroll";
-static const char *const HELP = "Scrolls the input by an integer number of pixels and loops it, for painting away tiling.\n\n"
+static const char *const HELP = "Scrolls the input by an integer number of pixels and loops it, for painting away tiling.\n"
+                                "Optionally repeats the input in a grid of tiles, with an offset per tile row for brick layouts.\n\n"
                                 "Author: 12/2021, Falk Hofmann, Julik Tarkhanov\n"
                                 "Version: 1.0.0";
 
@@ -18,23 +24,36 @@ class Scroll : public Iop
     double x, y;
     bool _invert;
     int dx, dy;
+    int _tiles[2];
+    double _row_offset;
 
-    int _width, _height;
+    int _fx, _fy, _width, _height;
+    int _nx, _ny;
+    Format _format, _fullFormat;
 
 public:
     Scroll(Node *node) : Iop(node),
                          _invert(false)
     {
         x = y = 0;
+        _tiles[0] = _tiles[1] = 1;
+        _row_offset = 0;
     }
 
-    signed int offsetCoord(signed int coord, int &total);
     virtual void knobs(Knob_Callback);
     const char *Class() const { return CLASS; }
     const char *node_help() const { return HELP; }
     static const Iop::Description d;
 };
 
+// format repeated nx times horizontally and ny times vertically, keeping
+// its origin.
+static void tile_format(const Format &format, int nx, int ny, Format &out)
+{
+    out = Format(format.width() + format.w() * (nx - 1), format.height() + format.h() * (ny - 1), format.pixel_aspect());
+    out.set(format.x(), format.y(), format.x() + format.w() * nx, format.y() + format.h() * ny);
+}
+
 void Scroll::_validate(bool)
 {
     // Figure out the integer translations. Floor(x+.5) is used so that
@@ -49,50 +68,55 @@ void Scroll::_validate(bool)
         dy *= -1;
     }
 
-    _width = input0().format().width() - 1;
-    _height = input0().format().height() - 1;
-
-    Box b(input0().info().x(), input0().info().y(), input0().info().r(), input0().info().t());
-    info_.intersect(b);
-}
-
-signed int Scroll::offsetCoord(signed int coord, int &total)
-{
-    if (coord < 0)
-    {
-        coord = total + (coord % total);
-    }
-    if (coord > total)
+    const Format &format = input0().format();
+    _fx = format.x();
+    _fy = format.y();
+    _width = format.w();
+    _height = format.h();
+    _nx = MAX(_tiles[0], 1);
+    _ny = MAX(_tiles[1], 1);
+
+    // The output covers the whole grid of tiles, every pixel in it is
+    // wrapped back into the input format.
+    if (_nx > 1 || _ny > 1)
     {
-        coord = coord % total;
+        tile_format(format, _nx, _ny, _format);
+        tile_format(input0().full_size_format(), _nx, _ny, _fullFormat);
+        info_.format(_format);
+        info_.full_size_format(_fullFormat);
     }
-    return coord;
+    info_.set(_fx, _fy, _fx + _width * _nx, _fy + _height * _ny);
 }
 
 void Scroll::_request(int x, int y, int r, int t, ChannelMask channels, int count)
 {
-    input0().request(channels, count);
+    // A source row is read once per row of tiles, one read serves all tiles
+    // across. Requesting it that many times makes Nuke cache the input
+    // instead of recomputing it per row of tiles.
+    input0().request(_fx, _fy, _fx + _width, _fy + _height, channels, count * _ny);
 }
 
 void Scroll::engine(int y, int x, int r, ChannelMask channels, Row &out)
 {
-    Pixel pixel(channels);
-    signed int theX, theY;
+    if (_width <= 0 || _height <= 0)
+    {
+        out.erase(channels);
+        return;
+    }
+
+    // Rows of tiles are shifted by the row offset, rounded to whole pixels.
+    const int tile_row = int(floor(double(y - _fy - dy) / _height));
+    const int shift = dx + int(floor(tile_row * _row_offset * _width + .5));
+    const int theY = _fy + nukular::wrap(y - _fy - dy, _height);
 
-    theY = y - dy;
-    theY = offsetCoord(theY, _height);
+    Row in(_fx, _fx + _width);
+    in.get(input0(), theY, _fx, _fx + _width, channels);
+    if (aborted())
+        return;
 
-    for (; x < r; x++)
+    foreach (z, channels)
     {
-        theX = x - dx;
-        theX = offsetCoord(theX, _width);
-
-        input0().at(theX, theY, pixel);
-        foreach (z, channels)
-        {
-            float *destBuf = out.writable(z);
-            *(destBuf + x) = pixel[z];
-        }
+        nukular::wrap_row(in[z] + _fx, _width, _fx + shift, out.writable(z), x, r);
     }
 }
 
@@ -104,6 +128,12 @@ void Scroll::knobs(Knob_Callback f)
     SetFlags(f, Knob::STARTLINE);
     Tooltip(f, "This does invert the translation.\n"
                "For easy wrapping around a paint node without any filtering.");
+    MultiInt_knob(f, _tiles, 2, "tiles", "tiles");
+    Tooltip(f, "Number of times the input is repeated horizontally and vertically.\n"
+               "All tiles are served from the same input rows, no filtering is done.");
+    Double_knob(f, &_row_offset, IRange(0, 1), "row_offset", "row offset");
+    Tooltip(f, "Horizontal offset of each row of tiles, as a fraction of the input width.\n"
+               "0.5 gives a brick layout.");
     Tab_knob(f, "Info");
     Text_knob(f, "Author", "Falk Hofmann, Julik Tarkhanov");
     Text_knob(f, "Date", "12/2021");
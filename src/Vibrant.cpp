@@ -15,20 +15,22 @@ static const char *const HELP = "This node adds colorfulness to less saturated a
 #include "DDImage/PixelIop.h"
 #include "DDImage/Row.h"
 #include "DDImage/Knobs.h"
-#include "DDImage/NukeWrapper.h"
 #include "DDImage/DDMath.h"
 #include "DDImage/RGB.h"
 
+#include "MaskedPixelIop.h"
+#include "NukularMath.h"
+
 using namespace DD::Image;
 
-class Vibrant : public PixelIop
+class Vibrant : public nukular::MaskedPixelIop
 {
 
   double _vibrant;
   int mode;
 
 public:
-  Vibrant(Node *node) : PixelIop(node)
+  Vibrant(Node *node) : MaskedPixelIop(node)
   {
     _vibrant = 1.0;
     mode = 0;
@@ -55,6 +57,7 @@ public:
   {
     set_out_channels(Mask_All);
     PixelIop::_validate(for_real);
+    validate_mask(for_real);
   }
 
   void pixel_engine(const Row &in, int y, int x, int r, ChannelMask channels, Row &out) override;
@@ -64,67 +67,19 @@ public:
   const char *node_help() const override { return HELP; }
 };
 
-enum
-{
-  REC709 = 0,
-  CCIR601,
-  AVERAGE,
-  MAXIMUM
-};
-
 static const char *mode_names[] = {
     "Rec 709", "Ccir 601", "Average", "Maximum", nullptr};
 
 void Vibrant::knobs(Knob_Callback f)
 {
+  channel_knobs(f);
   Double_knob(f, &_vibrant, IRange(0, 5), "vibrancy", "Vibrancy");
   Tooltip(f, "Adjust the amount of colorfulness. A value of 1 does not change the image.\n"
              "Values higher than 1 will add more color to less saturated areas, while Vibrancy values lower than "
              " 1 will reduce color of saturated areas");
   Enumeration_knob(f, &mode, mode_names, "mode", "luminance math");
   Tooltip(f, "Choose a mode to apply the greyscale conversion.");
-}
-
-static inline float y_convert_ccir601(float r, float g, float b)
-{
-  return r * 0.299f + g * 0.587f + b * 0.114f;
-}
-
-static inline float y_convert_avg(float r, float g, float b)
-{
-  return (r + g + b) / 3.0f;
-}
-
-static inline float y_convert_max(float r, float g, float b)
-{
-  if (g > r)
-    r = g;
-  if (b > r)
-    r = b;
-  return r;
-}
-
-static inline float y_convert_min(float r, float g, float b)
-{
-  if (g < r)
-    r = g;
-  if (b < r)
-    r = b;
-  return r;
-}
-
-static inline float calc_mask(float r, float g, float b)
-{
-  float mn = y_convert_min(r, g, b);
-  float mx = y_convert_max(r, g, b);
-  float t = clamp(1 - (MAX(mx, 1 - (mx - mn))));
-  return t;
-}
-
-static inline float calc_value(float y, float cIn, float vib, float m)
-{
-
-  return (lerp(y, cIn, vib) * m) + ((1 - m) * cIn);
+  mask_knobs(f);
 }
 
 void Vibrant::pixel_engine(const Row &in, int y, int x, int r,
@@ -157,58 +112,9 @@ void Vibrant::pixel_engine(const Row &in, int y, int x, int r,
     float *gOut = out.writable(gchan) + x;
     float *bOut = out.writable(bchan) + x;
 
-    const float *END = rIn + (r - x);
-
-    float y;
-    float fvibrance = float(_vibrant);
-
-    float m;
-    switch (mode)
-    {
-    case REC709:
-      while (rIn < END)
-      {
-        y = y_convert_rec709(*rIn, *gIn, *bIn);
-        m = calc_mask(*rIn, *gIn, *bIn);
-        *rOut++ = calc_value(y, *rIn++, fvibrance, m);
-        *gOut++ = calc_value(y, *gIn++, fvibrance, m);
-        *bOut++ = calc_value(y, *bIn++, fvibrance, m);
-      }
-      break;
-    case CCIR601:
-      while (rIn < END)
-      {
-        y = y_convert_ccir601(*rIn, *gIn, *bIn);
-        m = calc_mask(*rIn, *gIn, *bIn);
-        *rOut++ = calc_value(y, *rIn++, fvibrance, m);
-        *gOut++ = calc_value(y, *gIn++, fvibrance, m);
-        *bOut++ = calc_value(y, *bIn++, fvibrance, m);
-      }
-      break;
-    case AVERAGE:
-      while (rIn < END)
-      {
-        y = y_convert_avg(*rIn, *gIn, *bIn);
-        m = calc_mask(*rIn, *gIn, *bIn);
-        m = calc_mask(*rIn, *gIn, *bIn);
-        *rOut++ = calc_value(y, *rIn++, fvibrance, m);
-        *gOut++ = calc_value(y, *gIn++, fvibrance, m);
-        *bOut++ = calc_value(y, *bIn++, fvibrance, m);
-      }
-      break;
-    case MAXIMUM:
-      while (rIn < END)
-      {
-        y = y_convert_max(*rIn, *gIn, *bIn);
-        m = calc_mask(*rIn, *gIn, *bIn);
-        *rOut++ = calc_value(y, *rIn++, fvibrance, m);
-        *gOut++ = calc_value(y, *gIn++, fvibrance, m);
-        *bOut++ = calc_value(y, *bIn++, fvibrance, m);
-      }
-      break;
-    }
+    nukular::vibrant_span(mode, float(_vibrant), rIn, gIn, bIn, rOut, gOut, bOut, size_t(r - x));
   }
 }
 
-static Iop *build(Node *node) { return (new NukeWrapper(new Vibrant(node)))->channels(Mask_RGB); }
+static Iop *build(Node *node) { return new Vibrant(node); }
 const Iop::Description Vibrant::d("Vibrant", 0, build);
\ No newline at end of file